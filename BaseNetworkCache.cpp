@@ -0,0 +1,269 @@
+/*
+ * BaseNetworkCache.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "BaseNetworkCache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace remote_sensing {
+
+namespace {
+
+const char kMagic[4] = { 'P', 'N', 'B', 'C' };
+constexpr std::uint32_t kVersion = 2;
+
+struct FileHeader {
+	char magic[4];
+	std::uint32_t version;
+	std::uint64_t num_pixels;
+};
+
+struct RecordHeader {
+	std::uint32_t num_nodes;
+	// The length of the neighbor array, i.e. twice the number of edges.
+	std::uint32_t num_neighbors;
+	float min_weight;
+	std::uint32_t reserved;
+};
+
+inline std::uint64_t AlignRecord(std::uint64_t size) {
+	return (size + 7) / 8 * 8;
+}
+
+std::uint64_t GetRecordSize(std::uint64_t num_nodes,
+		std::uint64_t num_neighbors) {
+	return AlignRecord(
+			sizeof(RecordHeader) + sizeof(std::uint32_t) * (num_nodes + 1)
+					+ (sizeof(std::uint32_t) + sizeof(float)) * num_neighbors
+					+ 2 * sizeof(float) * num_nodes + num_nodes);
+}
+
+std::uint64_t GetRecordSize(const BaseNetworkData *base_network) {
+	if (base_network == nullptr)
+		return 0;
+	const simple_graph::CompactNetwork &network = base_network->network;
+	std::uint64_t num_neighbors = 0;
+	for (std::size_t i = 0; i < network.Size(); ++i) {
+		num_neighbors += network.GetDegree(i);
+	}
+	return GetRecordSize(network.Size(), num_neighbors);
+}
+
+template<typename T>
+void WriteArray(std::ofstream &out, const T *values, std::size_t size) {
+	out.write(reinterpret_cast<const char*>(values), sizeof(T) * size);
+}
+
+void WriteRecord(std::ofstream &out, const BaseNetworkData &base_network) {
+	const simple_graph::CompactNetwork &network = base_network.network;
+	const std::size_t num_nodes = network.Size();
+	std::vector<std::uint32_t> offsets(num_nodes + 1, 0);
+	for (std::size_t i = 0; i < num_nodes; ++i) {
+		offsets[i + 1] = offsets[i] + network.GetDegree(i);
+	}
+	RecordHeader header;
+	header.num_nodes = num_nodes;
+	header.num_neighbors = offsets[num_nodes];
+	header.min_weight = base_network.min_weight;
+	header.reserved = 0;
+	WriteArray(out, &header, 1);
+	WriteArray(out, offsets.data(), offsets.size());
+	for (std::size_t i = 0; i < num_nodes; ++i) {
+		WriteArray(out, network.GetNeighbors(i).begin(), network.GetDegree(i));
+	}
+	for (std::size_t i = 0; i < num_nodes; ++i) {
+		WriteArray(out, network.GetNeighborWeights(i), network.GetDegree(i));
+	}
+	// The measures are resized to the network, in case they are missing.
+	std::vector<float> measures(base_network.betweenness);
+	measures.resize(num_nodes, 0);
+	WriteArray(out, measures.data(), num_nodes);
+	measures = base_network.clustering;
+	measures.resize(num_nodes, 0);
+	WriteArray(out, measures.data(), num_nodes);
+	std::vector<char> giant_component(base_network.giant_component);
+	giant_component.resize(num_nodes, 0);
+	WriteArray(out, giant_component.data(), num_nodes);
+	const std::uint64_t size = GetRecordSize(num_nodes, header.num_neighbors);
+	const char padding[8] = { 0 };
+	WriteArray(out, padding,
+			size - (sizeof(RecordHeader) + 4 * (num_nodes + 1)
+					+ 8 * static_cast<std::uint64_t>(header.num_neighbors)
+					+ 9 * num_nodes));
+}
+
+} /* namespace */
+
+BaseNetworkCache::BaseNetworkCache() :
+		mapping_(nullptr), mapping_size_(0), num_pixels_(0) {
+}
+
+BaseNetworkCache::~BaseNetworkCache() {
+	Close();
+}
+
+bool BaseNetworkCache::Write(const std::string &path,
+		const std::vector<const BaseNetworkData*> &base_networks) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cerr << "cannot open " << path << " for writing" << std::endl;
+		return false;
+	}
+	FileHeader header;
+	std::memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.num_pixels = base_networks.size();
+	std::vector<std::uint64_t> index(base_networks.size() + 1);
+	index[0] = sizeof(FileHeader) + sizeof(std::uint64_t) * index.size();
+	for (std::size_t p = 0; p < base_networks.size(); ++p) {
+		index[p + 1] = index[p] + GetRecordSize(base_networks[p]);
+	}
+	WriteArray(out, &header, 1);
+	WriteArray(out, index.data(), index.size());
+	for (const BaseNetworkData *base_network : base_networks) {
+		if (base_network != nullptr)
+			WriteRecord(out, *base_network);
+	}
+	out.close();
+	if (!out) {
+		std::cerr << "failed to write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool BaseNetworkCache::Open(const std::string &path, std::size_t first_pixel,
+		std::size_t num_pixels) {
+	Close();
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cerr << "cannot open " << path << std::endl;
+		return false;
+	}
+	FileHeader header;
+	struct stat file_stat;
+	bool valid = pread(fd, &header, sizeof(header), 0) == sizeof(header)
+			&& std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0
+			&& header.version == kVersion && fstat(fd, &file_stat) == 0;
+	if (!valid) {
+		std::cerr << "invalid base network cache: " << path << std::endl;
+		close(fd);
+		return false;
+	}
+	if (first_pixel + num_pixels > header.num_pixels) {
+		std::cerr << "pixels [" << first_pixel << ", "
+				<< first_pixel + num_pixels << ") are not in " << path
+				<< " of " << header.num_pixels << " pixels" << std::endl;
+		close(fd);
+		return false;
+	}
+	// Only reads the part of the index that covers the range.
+	std::vector<std::uint64_t> offsets(num_pixels + 1);
+	const ssize_t index_size = sizeof(std::uint64_t) * offsets.size();
+	valid = pread(fd, offsets.data(), index_size,
+			sizeof(FileHeader) + sizeof(std::uint64_t) * first_pixel)
+			== index_size;
+	for (std::size_t p = 0; valid && p < num_pixels; ++p) {
+		valid = offsets[p] <= offsets[p + 1];
+	}
+	valid = valid
+			&& offsets[num_pixels]
+					<= static_cast<std::uint64_t>(file_stat.st_size);
+	if (!valid) {
+		std::cerr << "invalid index in " << path << std::endl;
+		close(fd);
+		return false;
+	}
+	const std::uint64_t page_size = sysconf(_SC_PAGESIZE);
+	const std::uint64_t begin = offsets[0] / page_size * page_size;
+	mapping_size_ = offsets[num_pixels] - begin;
+	if (mapping_size_ > 0) {
+		mapping_ = mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd,
+				begin);
+		if (mapping_ == MAP_FAILED) {
+			std::cerr << "cannot map " << path << std::endl;
+			mapping_ = nullptr;
+			mapping_size_ = 0;
+			close(fd);
+			return false;
+		}
+	}
+	close(fd);
+	index_.resize(offsets.size());
+	for (std::size_t p = 0; p < offsets.size(); ++p) {
+		index_[p] = offsets[p] - begin;
+	}
+	num_pixels_ = num_pixels;
+	return true;
+}
+
+void BaseNetworkCache::Close() {
+	if (mapping_ != nullptr) {
+		munmap(mapping_, mapping_size_);
+	}
+	mapping_ = nullptr;
+	mapping_size_ = 0;
+	index_.clear();
+	num_pixels_ = 0;
+}
+
+bool BaseNetworkCache::Read(std::size_t pixel,
+		BaseNetworkData &base_network) const {
+	if (pixel >= num_pixels_ || index_[pixel] == index_[pixel + 1]) {
+		return false;
+	}
+	const char *record = static_cast<const char*>(mapping_) + index_[pixel];
+	const std::uint64_t record_size = index_[pixel + 1] - index_[pixel];
+	RecordHeader header;
+	if (record_size < sizeof(header)) {
+		std::cerr << "invalid base network record of pixel " << pixel
+				<< std::endl;
+		return false;
+	}
+	std::memcpy(&header, record, sizeof(header));
+	const std::size_t num_nodes = header.num_nodes;
+	const std::uint32_t *offsets = reinterpret_cast<const std::uint32_t*>(record
+			+ sizeof(header));
+	const std::uint32_t *neighbors = offsets + num_nodes + 1;
+	// The offsets must describe the neighbor array and the neighbors must be
+	// nodes of the network, since the graph code does not check them.
+	bool valid = GetRecordSize(num_nodes, header.num_neighbors) == record_size
+			&& offsets[0] == 0 && offsets[num_nodes] == header.num_neighbors;
+	for (std::size_t i = 0; valid && i < num_nodes; ++i) {
+		valid = offsets[i] <= offsets[i + 1];
+	}
+	for (std::size_t k = 0; valid && k < header.num_neighbors; ++k) {
+		valid = neighbors[k] < num_nodes;
+	}
+	if (!valid) {
+		std::cerr << "invalid base network record of pixel " << pixel
+				<< std::endl;
+		return false;
+	}
+	const float *weights = reinterpret_cast<const float*>(neighbors
+			+ header.num_neighbors);
+	const float *betweenness = weights + header.num_neighbors;
+	const float *clustering = betweenness + num_nodes;
+	const char *giant_component =
+			reinterpret_cast<const char*>(clustering + num_nodes);
+	base_network.network = simple_graph::CompactNetwork(num_nodes, offsets,
+			neighbors, weights);
+	base_network.betweenness.assign(betweenness, betweenness + num_nodes);
+	base_network.clustering.assign(clustering, clustering + num_nodes);
+	base_network.giant_component.assign(giant_component,
+			giant_component + num_nodes);
+	base_network.min_weight = header.min_weight;
+	return true;
+}
+
+} /* namespace remote_sensing */
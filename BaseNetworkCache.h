@@ -0,0 +1,92 @@
+/*
+ * BaseNetworkCache.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_PHENONET_BASENETWORKCACHE_H_
+#define SIMPLEGRAPH_PHENONET_BASENETWORKCACHE_H_
+
+#include "CompactNetwork.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace remote_sensing {
+
+// The base network of a pixel along with its node measures, i.e. everything
+// the real-time analysis needs from the previous year.
+struct BaseNetworkData {
+	simple_graph::CompactNetwork network;
+	std::vector<float> betweenness;
+	std::vector<float> clustering;
+	// 1 for the nodes of the giant component.
+	std::vector<char> giant_component;
+	// The weight of the weakest edge of the network.
+	float min_weight;
+	// The peak (the transition cluster) of the network. It is not stored in
+	// the cache, but selected from the measures when they are loaded.
+	int peak_time_slice_index;
+	float peak_bridging_coefficient;
+};
+
+/*
+ * A binary file of the base networks of a tile of pixels. The file starts
+ * with a header (magic, version, number of pixels) and a tile-level index of
+ * num_pixels + 1 file offsets: the record of pixel p is stored in
+ * [index[p], index[p + 1]), and is empty if the pixel has no base network.
+ * Each record holds a fixed size header, the CSR arrays of the network, the
+ * betweenness and clustering coefficients and the giant component
+ * membership, with every array aligned to 4 bytes and records to 8 bytes.
+ * Values are stored in the native byte order. Records are checked when they
+ * are read (sizes, offsets and node ids), so a truncated or corrupted file
+ * is rejected rather than read out of bounds.
+ *
+ * A reader only maps the index and the records of its own pixel range, so
+ * the ranks of a job can share one file per tile.
+ */
+class BaseNetworkCache {
+public:
+	BaseNetworkCache();
+	~BaseNetworkCache();
+	BaseNetworkCache(const BaseNetworkCache &other) = delete;
+	BaseNetworkCache& operator=(const BaseNetworkCache &other) = delete;
+
+	// Writes the base networks of a tile, nullptr for the pixels without
+	// one. Returns false if the file cannot be written.
+	static bool Write(const std::string &path,
+			const std::vector<const BaseNetworkData*> &base_networks);
+
+	// Maps the records of the pixels [first_pixel, first_pixel + num_pixels)
+	// of a file, closing any previous one. Returns false if the file is
+	// invalid or does not contain the range.
+	bool Open(const std::string &path, std::size_t first_pixel,
+			std::size_t num_pixels);
+
+	void Close();
+
+	// The number of pixels of the mapped range.
+	inline std::size_t GetNumPixels() const {
+		return num_pixels_;
+	}
+
+	// Copies the base network of the pixel (relative to first_pixel) out of
+	// the mapped file. Returns false if the pixel has no base network or its
+	// record is invalid.
+	bool Read(std::size_t pixel, BaseNetworkData &base_network) const;
+
+private:
+	// The mapped part of the file.
+	void *mapping_;
+	std::size_t mapping_size_;
+	// The offsets of the records of the mapped range, relative to the
+	// beginning of the mapping.
+	std::vector<std::uint64_t> index_;
+	std::size_t num_pixels_;
+};
+
+} /* namespace remote_sensing */
+
+#endif /* SIMPLEGRAPH_PHENONET_BASENETWORKCACHE_H_ */
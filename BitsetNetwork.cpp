@@ -0,0 +1,49 @@
+/*
+ * BitsetNetwork.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "BitsetNetwork.h"
+
+namespace simple_graph {
+
+constexpr std::size_t BitsetNetwork::kWordBits;
+
+BitsetNetwork::BitsetNetwork(const Network &network) {
+	Build(network);
+}
+
+BitsetNetwork::BitsetNetwork(const CompactNetwork &network) {
+	Build(network);
+}
+
+void BitsetNetwork::Assign(const CompactNetwork &network) {
+	Build(network);
+}
+
+template<typename NetworkType>
+void BitsetNetwork::Build(const NetworkType &network) {
+	size_ = network.Size();
+	num_words_ = (size_ + kWordBits - 1) / kWordBits;
+	rows_.assign(size_ * num_words_, 0);
+	for (std::size_t i = 0; i < size_; ++i) {
+		Word *row = &rows_[i * num_words_];
+		for (auto neighbor : network.GetNeighbors(i)) {
+			row[neighbor / kWordBits] |= Word(1) << (neighbor % kWordBits);
+		}
+	}
+}
+
+std::size_t BitsetNetwork::GetDegree(std::size_t node_id) const {
+	if (node_id >= size_)
+		return 0;
+	std::size_t degree = 0;
+	const Word *row = GetRow(node_id);
+	for (std::size_t w = 0; w < num_words_; ++w) {
+		degree += __builtin_popcountll(row[w]);
+	}
+	return degree;
+}
+
+} /* namespace simple_graph */
@@ -0,0 +1,81 @@
+/*
+ * BitsetNetwork.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_BITSETNETWORK_H_
+#define SIMPLEGRAPH_BITSETNETWORK_H_
+
+#include "Network.h"
+#include "CompactNetwork.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace simple_graph {
+
+/*
+ * An unweighted, undirected graph stored as an adjacency matrix of bits: row
+ * i has bit j set if there is an edge between nodes i and j. Rows are padded
+ * to a whole number of 64-bit words, so whole neighborhoods can be combined
+ * with word-wide AND/OR. This is meant for small dense graphs (a few hundred
+ * nodes), since the memory grows with the square of the size.
+ */
+class BitsetNetwork {
+public:
+	typedef std::uint64_t Word;
+	static constexpr std::size_t kWordBits = 64;
+
+	// Creates an empty network (of size 0).
+	BitsetNetwork() :
+			size_(0), num_words_(0) {
+	}
+	explicit BitsetNetwork(const Network &network);
+	explicit BitsetNetwork(const CompactNetwork &network);
+
+	// Replaces the network with a copy of the given one, reusing the memory
+	// of the rows.
+	void Assign(const CompactNetwork &network);
+
+	inline bool IsEmpty() const {
+		return size_ == 0;
+	}
+
+	inline std::size_t Size() const {
+		return size_;
+	}
+
+	// The number of words in each row.
+	inline std::size_t GetNumWords() const {
+		return num_words_;
+	}
+
+	// Returns the row of the node (GetNumWords() words). node_id must be
+	// valid.
+	inline const Word* GetRow(std::size_t node_id) const {
+		return &rows_[node_id * num_words_];
+	}
+
+	// Check if there is an edge between two nodes.
+	inline bool IsEdge(std::size_t node_1, std::size_t node_2) const {
+		return node_1 < size_ && node_2 < size_
+				&& (GetRow(node_1)[node_2 / kWordBits] >> (node_2 % kWordBits))
+						& 1;
+	}
+
+	std::size_t GetDegree(std::size_t node_id) const;
+
+private:
+	std::size_t size_;
+	std::size_t num_words_;
+	std::vector<Word> rows_;
+
+	template<typename NetworkType>
+	void Build(const NetworkType &network);
+};
+
+} /* namespace simple_graph */
+
+#endif /* SIMPLEGRAPH_BITSETNETWORK_H_ */
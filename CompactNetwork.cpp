@@ -0,0 +1,158 @@
+/*
+ * CompactNetwork.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "CompactNetwork.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace simple_graph {
+
+CompactNetwork::CompactNetwork(std::size_t size,
+		const std::vector<std::pair<std::pair<int, int>, float>> &edges,
+		std::size_t num_edges) {
+	Assign(size, edges, num_edges);
+}
+
+void CompactNetwork::Assign(std::size_t size,
+		const std::vector<std::pair<std::pair<int, int>, float>> &edges,
+		std::size_t num_edges) {
+	num_edges = std::min(num_edges, edges.size());
+	offsets_.assign(size + 1, 0);
+	// Counts the degrees, then places the neighbors (counting sort).
+	auto valid_edge = [this](const std::pair<std::pair<int, int>, float> &edge) {
+		return edge.first.first >= 0 && edge.first.second >= 0
+				&& ValidateNodeId(edge.first.first)
+				&& ValidateNodeId(edge.first.second);
+	};
+	for (std::size_t i = 0; i < num_edges; ++i) {
+		if (!valid_edge(edges[i]))
+			continue;
+		++offsets_[edges[i].first.first + 1];
+		if (edges[i].first.first != edges[i].first.second)
+			++offsets_[edges[i].first.second + 1];
+	}
+	for (std::size_t i = 0; i < size; ++i) {
+		offsets_[i + 1] += offsets_[i];
+	}
+	neighbors_.resize(offsets_[size]);
+	weights_.resize(offsets_[size]);
+	std::vector<std::uint32_t> &next = next_;
+	next.assign(offsets_.begin(), offsets_.end() - 1);
+	for (std::size_t i = 0; i < num_edges; ++i) {
+		if (!valid_edge(edges[i]))
+			continue;
+		const int node_1 = edges[i].first.first;
+		const int node_2 = edges[i].first.second;
+		neighbors_[next[node_1]] = node_2;
+		weights_[next[node_1]++] = edges[i].second;
+		if (node_1 != node_2) {
+			neighbors_[next[node_2]] = node_1;
+			weights_[next[node_2]++] = edges[i].second;
+		}
+	}
+	SortNeighbors();
+}
+
+CompactNetwork::CompactNetwork(const Network &network) {
+	const std::size_t size = network.Size();
+	offsets_.assign(size + 1, 0);
+	for (std::size_t i = 0; i < size; ++i) {
+		offsets_[i + 1] = offsets_[i] + network.GetDegree(i);
+	}
+	neighbors_.reserve(offsets_[size]);
+	weights_.reserve(offsets_[size]);
+	for (std::size_t i = 0; i < size; ++i) {
+		for (auto neighbor : network.GetNeighbors(i)) {
+			neighbors_.push_back(neighbor);
+			weights_.push_back(network.GetWeight(i, neighbor));
+		}
+	}
+	SortNeighbors();
+}
+
+CompactNetwork::CompactNetwork(std::size_t size, const std::uint32_t *offsets,
+		const NodeId *neighbors, const float *weights) :
+		offsets_(offsets, offsets + size + 1), neighbors_(neighbors,
+				neighbors + offsets[size]), weights_(weights,
+				weights + offsets[size]) {
+}
+
+bool CompactNetwork::IsEdge(std::size_t node_1, std::size_t node_2) const {
+	if (ValidateNodeId(node_1) && ValidateNodeId(node_2)) {
+		const NeighborRange neighbors = GetNeighbors(node_1);
+		return std::binary_search(neighbors.begin(), neighbors.end(),
+				static_cast<NodeId>(node_2));
+	}
+	return false;
+}
+
+CompactNetwork::NeighborRange CompactNetwork::GetNeighbors(
+		std::size_t node_id) const {
+	if (!ValidateNodeId(node_id))
+		return NeighborRange(nullptr, nullptr);
+	const NodeId *neighbors = neighbors_.data();
+	return NeighborRange(neighbors + offsets_[node_id],
+			neighbors + offsets_[node_id + 1]);
+}
+
+const float* CompactNetwork::GetNeighborWeights(std::size_t node_id) const {
+	if (!ValidateNodeId(node_id))
+		return nullptr;
+	return weights_.data() + offsets_[node_id];
+}
+
+std::size_t CompactNetwork::GetDegree(std::size_t node_id) const {
+	if (!ValidateNodeId(node_id))
+		return 0;
+	return offsets_[node_id + 1] - offsets_[node_id];
+}
+
+bool CompactNetwork::ValidateNodeId(std::size_t node_id) const {
+	if (node_id >= Size()) {
+		std::cerr << "invalid node_id: " << node_id << " v.s. network size: "
+				<< Size() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void CompactNetwork::SortNeighbors() {
+	std::vector<UnsortedNeighbor> &adjacency = adjacency_;
+	std::uint32_t begin = 0, size = 0;
+	for (std::size_t i = 0; i < Size(); ++i) {
+		const std::uint32_t end = offsets_[i + 1];
+		adjacency.clear();
+		for (std::uint32_t k = begin; k < end; ++k) {
+			adjacency.push_back( { neighbors_[k], k, weights_[k] });
+		}
+		// Sorted by position among equal nodes, like a stable sort (which
+		// would allocate a buffer).
+		std::sort(adjacency.begin(), adjacency.end(),
+				[](const UnsortedNeighbor &a, const UnsortedNeighbor &b) {
+					return a.node_id < b.node_id
+							|| (a.node_id == b.node_id && a.position < b.position);
+				});
+		offsets_[i] = size;
+		for (std::size_t k = 0; k < adjacency.size(); ++k) {
+			// Keeps the last weight of duplicated edges.
+			if (k + 1 < adjacency.size()
+					&& adjacency[k + 1].node_id == adjacency[k].node_id)
+				continue;
+			neighbors_[size] = adjacency[k].node_id;
+			weights_[size] = adjacency[k].weight;
+			++size;
+		}
+		begin = end;
+	}
+	if (!offsets_.empty()) {
+		offsets_.back() = size;
+	}
+	neighbors_.resize(size);
+	weights_.resize(size);
+}
+
+} /* namespace simple_graph */
@@ -0,0 +1,128 @@
+/*
+ * CompactNetwork.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_COMPACTNETWORK_H_
+#define SIMPLEGRAPH_COMPACTNETWORK_H_
+
+#include "Network.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace simple_graph {
+
+/*
+ * An immutable undirected graph stored in the compressed sparse row (CSR)
+ * format: the neighbors of all nodes are stored in one contiguous array,
+ * sorted by node_id, along with their edge weights. Neighbor ranges are
+ * returned as views, so iterating over them does not allocate. Use Network
+ * when the graph needs to be modified.
+ */
+class CompactNetwork {
+public:
+	typedef std::uint32_t NodeId;
+
+	// A read only view of the neighbors of a node.
+	class NeighborRange {
+	public:
+		NeighborRange(const NodeId *begin, const NodeId *end) :
+				begin_(begin), end_(end) {
+		}
+		inline const NodeId* begin() const {
+			return begin_;
+		}
+		inline const NodeId* end() const {
+			return end_;
+		}
+		inline std::size_t size() const {
+			return end_ - begin_;
+		}
+		inline bool empty() const {
+			return begin_ == end_;
+		}
+		inline NodeId operator[](std::size_t i) const {
+			return begin_[i];
+		}
+	private:
+		const NodeId *begin_;
+		const NodeId *end_;
+	};
+
+	// Creates an empty network (of size 0).
+	CompactNetwork() {
+	}
+
+	// Builds a network of the given size from the first num_edges edges,
+	// stored as <<node_1, node_2>, weight>. If an edge is given more than
+	// once, the last weight is kept (like Network::AddOrUpdateEdge()).
+	CompactNetwork(std::size_t size,
+			const std::vector<std::pair<std::pair<int, int>, float>> &edges,
+			std::size_t num_edges);
+
+	// Replaces the network with the one built by the constructor above,
+	// reusing the memory of this one, so that rebuilding networks that are
+	// not larger than before does not allocate.
+	void Assign(std::size_t size,
+			const std::vector<std::pair<std::pair<int, int>, float>> &edges,
+			std::size_t num_edges);
+
+	// Copies a network.
+	explicit CompactNetwork(const Network &network);
+
+	// Copies a network that is already in the CSR format with sorted
+	// neighbors, e.g. read back from a file: the neighbors of node i are
+	// neighbors[offsets[i], offsets[i + 1]).
+	CompactNetwork(std::size_t size, const std::uint32_t *offsets,
+			const NodeId *neighbors, const float *weights);
+
+	inline bool IsEmpty() const {
+		return Size() == 0;
+	}
+
+	inline std::size_t Size() const {
+		return offsets_.empty() ? 0 : offsets_.size() - 1;
+	}
+
+	// Check if there is an edge between two nodes.
+	bool IsEdge(std::size_t node_1, std::size_t node_2) const;
+
+	// Returns the neighbors of the node, sorted by node_id.
+	NeighborRange GetNeighbors(std::size_t node_id) const;
+
+	// Returns the weights of the edges to the neighbors of the node, in the
+	// same order as GetNeighbors().
+	const float* GetNeighborWeights(std::size_t node_id) const;
+
+	std::size_t GetDegree(std::size_t node_id) const;
+
+private:
+	// The neighbors of node i are stored in
+	// neighbors_[offsets_[i], offsets_[i + 1]).
+	std::vector<std::uint32_t> offsets_;
+	std::vector<NodeId> neighbors_;
+	std::vector<float> weights_;
+	// A neighbor of a node being sorted, with its position in the unsorted
+	// neighbors to keep the order of duplicated edges.
+	struct UnsortedNeighbor {
+		NodeId node_id;
+		std::uint32_t position;
+		float weight;
+	};
+	// The buffers of Assign(): the next free position of the neighbors of
+	// each node, and the neighbors of one node.
+	std::vector<std::uint32_t> next_;
+	std::vector<UnsortedNeighbor> adjacency_;
+
+	bool ValidateNodeId(std::size_t node_id) const;
+	// Sorts the neighbors of each node and removes duplicated edges.
+	void SortNeighbors();
+};
+
+} /* namespace simple_graph */
+
+#endif /* SIMPLEGRAPH_COMPACTNETWORK_H_ */
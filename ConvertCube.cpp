@@ -0,0 +1,97 @@
+//============================================================================
+// Name        : ConvertCube.cpp
+// Author      : RSSI (rssiuiuc@gmail.com)
+// Description : Converts the day_N.txt example data into a binary tile cube
+//============================================================================
+
+#include "TextLoader.h"
+#include "TileCube.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace remote_sensing;
+
+int main(int argc, char* argv[]) {
+  // The days are parsed in parallel in batches, which are then written one
+  // at a time.
+  const int num_days_per_batch = 32;
+
+  if (argc < 6) {
+    cerr << "Usage: " << argv[0] << " <input directory> <output cube> "
+	 << "<number of days> <number of pixels> <number of bands> "
+	 << "[pixels per chunk] [float32 | int16 <scale> | uint16 <scale>]"
+	 << endl
+	 << "Reads <input directory>/day_1.txt ... day_N.txt, which hold one "
+	 << "line per pixel with the values of its bands." << endl;
+    return EXIT_FAILURE;
+  }
+  const string input_directory = argv[1];
+  const string output_path = argv[2];
+  TileCubeInfo info;
+  info.num_time_slices = atoi(argv[3]);
+  info.num_pixels = atoll(argv[4]);
+  info.num_bands = atoi(argv[5]);
+  // One chunk of all pixels by default, i.e. every band of every day is
+  // stored contiguously like the text files.
+  info.pixels_per_chunk = argc > 6 ? atoi(argv[6]) : info.num_pixels;
+  info.data_type = CubeDataType::kFloat32;
+  float scale = 1;
+  if (argc > 7) {
+    const string data_type = argv[7];
+    if (data_type == "int16" || data_type == "uint16") {
+      info.data_type = data_type == "int16" ? CubeDataType::kInt16
+	: CubeDataType::kUInt16;
+      scale = argc > 8 ? atof(argv[8]) : 0;
+    } else if (data_type != "float32") {
+      cerr << "Unknown data type: " << data_type << endl;
+      return EXIT_FAILURE;
+    }
+    if (!(scale > 0)) {
+      cerr << "The scale must be positive." << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  info.scales.assign(info.num_bands > 0 ? info.num_bands : 0, scale);
+  info.offsets.assign(info.scales.size(), 0);
+
+  // The days [batch_first, batch_first + batch_size), by day and band.
+  vector<float> batch;
+  int batch_first = 0, batch_size = 0;
+  const size_t num_day_values = info.num_pixels * info.num_bands;
+  auto read_time_slice = [&](int time_slice_index,
+			     const vector<float*> &bands) {
+    if (time_slice_index < batch_first
+	|| time_slice_index >= batch_first + batch_size) {
+      batch_first = time_slice_index;
+      batch_size = min(num_days_per_batch,
+		       info.num_time_slices - time_slice_index);
+      vector<string> paths;
+      for (int i = 0; i < batch_size; ++i) {
+	paths.push_back(input_directory + "/day_"
+			+ to_string(batch_first + i + 1) + ".txt");
+      }
+      batch.resize(batch_size * num_day_values);
+      if (!TextLoader::LoadTimeSlices(paths, 0, info.num_pixels,
+				      info.num_bands, batch.data())) {
+	batch_size = 0;
+	return false;
+      }
+    }
+    const float *values = batch.data()
+      + (time_slice_index - batch_first) * num_day_values;
+    for (size_t band = 0; band < bands.size(); ++band) {
+      copy(values + band * info.num_pixels,
+	   values + (band + 1) * info.num_pixels, bands[band]);
+    }
+    return true;
+  };
+  if (!TileCube::Write(output_path, info, read_time_slice)) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
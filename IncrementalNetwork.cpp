@@ -0,0 +1,278 @@
+/*
+ * IncrementalNetwork.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "IncrementalNetwork.h"
+
+#include <algorithm>
+
+namespace simple_graph {
+
+namespace {
+
+// Returns the number of common elements of two sorted ranges.
+template<typename Iterator1, typename Iterator2>
+std::size_t CountCommon(Iterator1 first1, Iterator1 last1, Iterator2 first2,
+		Iterator2 last2) {
+	std::size_t count = 0;
+	while (first1 != last1 && first2 != last2) {
+		if (*first1 < *first2) {
+			++first1;
+		} else if (*first2 < *first1) {
+			++first2;
+		} else {
+			++count;
+			++first1;
+			++first2;
+		}
+	}
+	return count;
+}
+
+} /* namespace */
+
+IncrementalNetwork::IncrementalNetwork(const CompactNetwork &network) :
+		adjacency_(network.Size()), distance_(network.Size()), num_path_(
+				network.Size()), dependency_(network.Size()), betweenness_(
+				network.Size(), 0), neighbor_edges_(network.Size(), 0), num_affected_sources_(
+				0), target_dependency_(network.Size(), 0) {
+	const std::size_t size = network.Size();
+	for (std::size_t i = 0; i < size; ++i) {
+		for (auto neighbor : network.GetNeighbors(i)) {
+			// Self loops are not part of any shortest path or triangle.
+			if (neighbor != i)
+				adjacency_[i].push_back(neighbor);
+		}
+	}
+	for (std::size_t i = 0; i < size; ++i) {
+		// Each edge between two neighbors is found from both ends.
+		std::size_t twice_edge_count = 0;
+		for (auto neighbor : adjacency_[i]) {
+			twice_edge_count += CountCommon(adjacency_[i].begin(),
+					adjacency_[i].end(), adjacency_[neighbor].begin(),
+					adjacency_[neighbor].end());
+		}
+		neighbor_edges_[i] = twice_edge_count / 2;
+	}
+	for (std::size_t i = 0; i < size; ++i) {
+		Search(i);
+	}
+}
+
+std::size_t IncrementalNetwork::AddNode(
+		const std::vector<std::size_t> &neighbors) {
+	const std::size_t new_node = Size();
+	std::vector<NodeId> new_neighbors;
+	for (auto neighbor : neighbors) {
+		if (neighbor < new_node)
+			new_neighbors.push_back(neighbor);
+	}
+	std::sort(new_neighbors.begin(), new_neighbors.end());
+	new_neighbors.erase(std::unique(new_neighbors.begin(), new_neighbors.end()),
+			new_neighbors.end());
+
+	// The new edges only close triangles between the new node and two of its
+	// neighbors.
+	std::size_t twice_edge_count = 0;
+	for (auto neighbor : new_neighbors) {
+		const std::vector<NodeId> &common = adjacency_[neighbor];
+		const std::size_t count = CountCommon(new_neighbors.begin(),
+				new_neighbors.end(), common.begin(), common.end());
+		neighbor_edges_[neighbor] += count;
+		twice_edge_count += count;
+	}
+	neighbor_edges_.push_back(twice_edge_count / 2);
+	// The new node has the largest node_id, so the lists stay sorted.
+	for (auto neighbor : new_neighbors) {
+		adjacency_[neighbor].push_back(new_node);
+	}
+	adjacency_.push_back(std::move(new_neighbors));
+	betweenness_.push_back(0);
+	target_dependency_.push_back(0);
+
+	num_affected_sources_ = 0;
+	const std::vector<NodeId> &added = adjacency_[new_node];
+	for (std::size_t source = 0; source < new_node; ++source) {
+		std::vector<std::int32_t> &distance = distance_[source];
+		std::vector<double> &num_path = num_path_[source];
+		std::vector<double> &dependency = dependency_[source];
+		// The closest and the farthest neighbors of the new node.
+		std::int32_t min_distance = -1, max_distance = -1;
+		bool all_reached = true;
+		for (auto neighbor : added) {
+			const std::int32_t d = distance[neighbor];
+			if (d < 0) {
+				all_reached = false;
+				continue;
+			}
+			if (min_distance < 0 || d < min_distance)
+				min_distance = d;
+			max_distance = std::max(max_distance, d);
+		}
+		if (min_distance < 0) {
+			// The new node cannot be reached from the source.
+			distance.push_back(-1);
+			num_path.push_back(0);
+			dependency.push_back(0);
+		} else if (all_reached && max_distance <= min_distance + 1) {
+			// No path through the new node is as short as an existing one, so
+			// the new node is a leaf: only the paths to it are added.
+			double new_num_path = 0;
+			for (auto neighbor : added) {
+				if (distance[neighbor] == min_distance)
+					new_num_path += num_path[neighbor];
+			}
+			distance.push_back(min_distance + 1);
+			num_path.push_back(new_num_path);
+			dependency.push_back(0);
+			AccumulateTargetDependencies(source, new_node);
+		} else {
+			// Replaces the dependencies of the source.
+			for (std::size_t v = 0; v < new_node; ++v) {
+				betweenness_[v] -= dependency[v];
+			}
+			Search(source);
+			++num_affected_sources_;
+		}
+	}
+	distance_.emplace_back();
+	num_path_.emplace_back();
+	dependency_.emplace_back();
+	Search(new_node);
+	return new_node;
+}
+
+std::vector<float> IncrementalNetwork::GetNodeBetweennessCentrality(
+		std::size_t normalization_size) const {
+	const std::size_t network_size = Size();
+	if (normalization_size == 0) {
+		normalization_size = network_size;
+	}
+	std::vector<float> betweenness(network_size, 0.0);
+	for (std::size_t i = 0; i < network_size; ++i) {
+		betweenness[i] = betweenness_[i];
+		if (normalization_size > 2)
+			betweenness[i] /= (normalization_size - 1)
+					* (normalization_size - 2);
+	}
+	return betweenness;
+}
+
+std::vector<float> IncrementalNetwork::GetAllClusteringCoefficients() const {
+	std::vector<float> clustering(Size(), 0.0);
+	for (std::size_t i = 0; i < Size(); ++i) {
+		const std::size_t degree = adjacency_[i].size();
+		if (degree < 2)
+			continue;
+		clustering[i] = static_cast<float>(neighbor_edges_[i]) * 2.0
+				/ static_cast<float>(degree * (degree - 1));
+	}
+	return clustering;
+}
+
+std::vector<std::size_t> IncrementalNetwork::ExtractGiantComponent() const {
+	// Two nodes are connected iff one can be reached from the other.
+	std::vector<char> visited(Size(), 0);
+	std::vector<std::size_t> first_component, giant_component;
+	std::size_t num_components = 0;
+	for (std::size_t i = 0; i < Size(); ++i) {
+		if (visited[i])
+			continue;
+		std::vector<std::size_t> component;
+		for (std::size_t v = i; v < Size(); ++v) {
+			if (distance_[i][v] >= 0) {
+				visited[v] = 1;
+				component.push_back(v);
+			}
+		}
+		if (num_components++ == 0) {
+			first_component.swap(component);
+		} else if (component.size() > giant_component.size()) {
+			giant_component.swap(component);
+		}
+	}
+	return num_components == 1 ? first_component : giant_component;
+}
+
+void IncrementalNetwork::Search(std::size_t source) {
+	std::vector<std::int32_t> &distance = distance_[source];
+	std::vector<double> &num_path = num_path_[source];
+	std::vector<double> &dependency = dependency_[source];
+	distance.assign(Size(), -1);
+	num_path.assign(Size(), 0);
+	dependency.assign(Size(), 0);
+	order_.clear();
+	distance[source] = 0;
+	num_path[source] = 1;
+	order_.push_back(source);
+	for (std::size_t k = 0; k < order_.size(); ++k) {
+		const NodeId cur = order_[k];
+		for (auto next : adjacency_[cur]) {
+			if (distance[next] < 0) {
+				distance[next] = distance[cur] + 1;
+				order_.push_back(next);
+			}
+			if (distance[next] == distance[cur] + 1) {
+				num_path[next] += num_path[cur];
+			}
+		}
+	}
+	// Nodes are accumulated in the reverse order in which they are visited.
+	for (std::size_t k = order_.size(); k-- > 0;) {
+		const NodeId cur = order_[k];
+		for (auto pre : adjacency_[cur]) {
+			if (distance[pre] == distance[cur] - 1) {
+				dependency[pre] += num_path[pre] / num_path[cur]
+						* (1 + dependency[cur]);
+			}
+		}
+		if (cur != source) {
+			betweenness_[cur] += dependency[cur];
+		}
+	}
+	// The source is not counted in its own betweenness.
+	dependency[source] = 0;
+}
+
+void IncrementalNetwork::AccumulateTargetDependencies(std::size_t source,
+		std::size_t target) {
+	const std::vector<std::int32_t> &distance = distance_[source];
+	const std::vector<double> &num_path = num_path_[source];
+	std::vector<double> &dependency = dependency_[source];
+	const std::int32_t target_level = distance[target];
+	touched_by_level_.resize(
+			std::max<std::size_t>(touched_by_level_.size(), target_level));
+	// Walks up the shortest path DAG from the target, level by level. The
+	// dependencies are positive once a node is reached.
+	for (auto pre : adjacency_[target]) {
+		if (distance[pre] == target_level - 1) {
+			if (target_dependency_[pre] == 0)
+				touched_by_level_[target_level - 1].push_back(pre);
+			target_dependency_[pre] += num_path[pre] / num_path[target];
+		}
+	}
+	for (std::int32_t level = target_level - 1; level > 0; --level) {
+		for (auto cur : touched_by_level_[level]) {
+			betweenness_[cur] += target_dependency_[cur];
+			dependency[cur] += target_dependency_[cur];
+			for (auto pre : adjacency_[cur]) {
+				if (distance[pre] == level - 1) {
+					if (target_dependency_[pre] == 0)
+						touched_by_level_[level - 1].push_back(pre);
+					target_dependency_[pre] += num_path[pre] / num_path[cur]
+							* target_dependency_[cur];
+				}
+			}
+		}
+	}
+	for (std::int32_t level = 0; level < target_level; ++level) {
+		for (auto node : touched_by_level_[level]) {
+			target_dependency_[node] = 0;
+		}
+		touched_by_level_[level].clear();
+	}
+}
+
+} /* namespace simple_graph */
@@ -0,0 +1,104 @@
+/*
+ * IncrementalNetwork.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_INCREMENTALNETWORK_H_
+#define SIMPLEGRAPH_INCREMENTALNETWORK_H_
+
+#include "CompactNetwork.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace simple_graph {
+
+/*
+ * An unweighted, undirected graph that keeps its node betweenness centrality
+ * and clustering coefficients up to date while nodes are added to it.
+ *
+ * The shortest path distances, counts and dependencies from every source
+ * node are kept: 20 bytes per pair of nodes, e.g. about 2.7 MB for 365
+ * nodes, so only the networks that are being updated should be kept in this
+ * form. When a node x is added with the neighbors S, a source s
+ * whose distances to S differ by at most one is not affected: x is a leaf of
+ * its shortest path DAG, so only the paths ending at x are added by walking
+ * up from x. The other (affected) sources are recomputed with Brandes'
+ * algorithm, and x itself is added as a new source. The clustering
+ * coefficients only change for x and its neighbors.
+ */
+class IncrementalNetwork {
+public:
+	typedef std::uint32_t NodeId;
+
+	// Starts from the given network (edge weights are ignored).
+	explicit IncrementalNetwork(const CompactNetwork &network);
+
+	inline std::size_t Size() const {
+		return adjacency_.size();
+	}
+
+	// Adds a node connected to the given nodes and updates the measures.
+	// Invalid and duplicated neighbors are ignored. Returns the node_id of
+	// the new node.
+	std::size_t AddNode(const std::vector<std::size_t> &neighbors);
+
+	// Returns the neighbors of the node, sorted by node_id.
+	const std::vector<NodeId>& GetNeighbors(std::size_t node_id) const {
+		return adjacency_.at(node_id);
+	}
+
+	// Returns the betweenness centrality of all nodes, normalized like
+	// utils::GetNodeBetweennessCentrality() for a network of
+	// normalization_size nodes (Size() if 0).
+	std::vector<float> GetNodeBetweennessCentrality(
+			std::size_t normalization_size = 0) const;
+
+	// Returns the clustering coefficients of all nodes, the same as
+	// utils::GetAllClusteringCoefficients().
+	std::vector<float> GetAllClusteringCoefficients() const;
+
+	// Returns the nodes of the giant component, sorted by node_id. It is
+	// selected like utils::ExtractGiantComponent() does for the base
+	// networks: the component of node 0 is only selected if it is the only
+	// one, otherwise the first largest of the other components is.
+	std::vector<std::size_t> ExtractGiantComponent() const;
+
+	// The number of sources that were recomputed by the last AddNode().
+	inline std::size_t GetNumAffectedSources() const {
+		return num_affected_sources_;
+	}
+
+private:
+	std::vector<std::vector<NodeId>> adjacency_;
+	// distance_[s][v] is the length of the shortest paths from s to v (-1
+	// if v cannot be reached), num_path_[s][v] their number and
+	// dependency_[s][v] the dependency of s on v.
+	std::vector<std::vector<std::int32_t>> distance_;
+	std::vector<std::vector<double>> num_path_;
+	std::vector<std::vector<double>> dependency_;
+	// The sum of the dependencies of all sources on each node (not
+	// normalized).
+	std::vector<double> betweenness_;
+	// The number of edges between the neighbors of each node.
+	std::vector<std::size_t> neighbor_edges_;
+	std::size_t num_affected_sources_;
+
+	// Buffers reused by the searches.
+	std::vector<NodeId> order_;
+	std::vector<double> target_dependency_;
+	std::vector<std::vector<NodeId>> touched_by_level_;
+
+	// Runs Brandes' algorithm from the source: stores its distances, path
+	// counts and dependencies, and adds the dependencies to the betweenness.
+	void Search(std::size_t source);
+	// Adds the dependencies of the source on the shortest paths that end at
+	// target, which must be a leaf of the shortest path DAG of the source.
+	void AccumulateTargetDependencies(std::size_t source, std::size_t target);
+};
+
+} /* namespace simple_graph */
+
+#endif /* SIMPLEGRAPH_INCREMENTALNETWORK_H_ */
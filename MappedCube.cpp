@@ -0,0 +1,106 @@
+/*
+ * MappedCube.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "MappedCube.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+
+namespace remote_sensing {
+
+MappedCube::MappedCube() :
+		mapping_(nullptr), mapping_size_(0), data_(nullptr) {
+}
+
+MappedCube::~MappedCube() {
+	Close();
+}
+
+bool MappedCube::Open(const std::string &path) {
+	Close();
+	TileCubeInfo info;
+	if (!TileCube::ReadInfo(path, info)) {
+		return false;
+	}
+	if (info.data_type != CubeDataType::kFloat32) {
+		std::cerr << path << " is quantized and cannot be mapped" << std::endl;
+		return false;
+	}
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cerr << "cannot open " << path << std::endl;
+		return false;
+	}
+	struct stat file_status;
+	const std::uint64_t data_size = info.num_pixels * info.num_time_slices
+			* info.num_bands * sizeof(float);
+	if (fstat(fd, &file_status) != 0
+			|| static_cast<std::uint64_t>(file_status.st_size)
+					< info.data_offset + data_size) {
+		std::cerr << path << " is truncated" << std::endl;
+		close(fd);
+		return false;
+	}
+	void *mapping = mmap(nullptr, file_status.st_size, PROT_READ, MAP_SHARED,
+			fd, 0);
+	// The mapping stays valid after the file is closed.
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		std::cerr << "cannot map " << path << std::endl;
+		return false;
+	}
+	// The pixels are usually processed in the order of the file.
+	madvise(mapping, file_status.st_size, MADV_SEQUENTIAL);
+	mapping_ = mapping;
+	mapping_size_ = file_status.st_size;
+	data_ = reinterpret_cast<const float*>(static_cast<const char*>(mapping)
+			+ info.data_offset);
+	info_ = info;
+	return true;
+}
+
+void MappedCube::Close() {
+	if (mapping_ != nullptr) {
+		munmap(mapping_, mapping_size_);
+	}
+	mapping_ = nullptr;
+	mapping_size_ = 0;
+	data_ = nullptr;
+}
+
+PixelView<float> MappedCube::GetPixel(std::uint64_t pixel) const {
+	if (pixel >= GetNumPixels()) {
+		return PixelView<float>();
+	}
+	const std::uint64_t chunk_first_pixel = pixel / info_.pixels_per_chunk
+			* info_.pixels_per_chunk;
+	const std::uint64_t chunk_size = std::min<std::uint64_t>(
+			info_.pixels_per_chunk, info_.num_pixels - chunk_first_pixel);
+	// Value (t, b) of the pixel is at (t * num_bands + b) * chunk_size in its
+	// chunk.
+	const float *values = data_
+			+ chunk_first_pixel * info_.num_time_slices * info_.num_bands
+			+ (pixel - chunk_first_pixel);
+	return PixelView<float>(values, info_.num_time_slices, info_.num_bands,
+			info_.num_bands * chunk_size, chunk_size);
+}
+
+std::vector<PixelView<float>> MappedCube::GetPixels(std::uint64_t first_pixel,
+		std::uint64_t num_pixels) const {
+	std::vector<PixelView<float>> pixels;
+	const std::uint64_t end_pixel = std::min(GetNumPixels(),
+			first_pixel + num_pixels);
+	for (std::uint64_t p = first_pixel; p < end_pixel; ++p) {
+		pixels.push_back(GetPixel(p));
+	}
+	return pixels;
+}
+
+} /* namespace remote_sensing */
@@ -0,0 +1,67 @@
+/*
+ * MappedCube.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_PHENONET_MAPPEDCUBE_H_
+#define SIMPLEGRAPH_PHENONET_MAPPEDCUBE_H_
+
+#include "TileCube.h"
+#include "TimeSeries.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace remote_sensing {
+
+/*
+ * A float32 tile cube mapped read-only into memory, for runs on a single
+ * node. The pixels are viewed in place with their strides in the chunk
+ * layout of the cube, so nothing is read, decoded or copied until the
+ * similarity kernels touch the values, and the tasks (or processes) of a
+ * node share the page cache instead of holding their own copies. Quantized
+ * cubes have to be decoded, so they are read with TileCube::Read instead.
+ */
+class MappedCube {
+public:
+	MappedCube();
+	virtual ~MappedCube();
+	MappedCube(const MappedCube &other) = delete;
+	MappedCube& operator=(const MappedCube &other) = delete;
+
+	// Maps a cube, closing any previous one. Returns false if the file is
+	// not a valid float32 cube or cannot be mapped.
+	bool Open(const std::string &path);
+
+	void Close();
+
+	inline const TileCubeInfo& GetInfo() const {
+		return info_;
+	}
+
+	inline std::uint64_t GetNumPixels() const {
+		return data_ != nullptr ? info_.num_pixels : 0;
+	}
+
+	// The view of a pixel, which is valid until the cube is closed.
+	PixelView<float> GetPixel(std::uint64_t pixel) const;
+
+	// The views of the pixels [first_pixel, first_pixel + num_pixels), which
+	// are clipped to the pixels of the cube.
+	std::vector<PixelView<float>> GetPixels(std::uint64_t first_pixel,
+			std::uint64_t num_pixels) const;
+
+private:
+	TileCubeInfo info_;
+	void *mapping_;
+	std::size_t mapping_size_;
+	// The first value of the cube, in the mapping.
+	const float *data_;
+};
+
+} /* namespace remote_sensing */
+
+#endif /* SIMPLEGRAPH_PHENONET_MAPPEDCUBE_H_ */
@@ -40,6 +40,15 @@ std::vector<std::size_t> Network::GetNeighbors(std::size_t node_id) const {
 	return neighbors;
 }
 
+float Network::GetWeight(std::size_t node_1, std::size_t node_2) const {
+	if (ValidateNodeId(node_1) && ValidateNodeId(node_2)) {
+		const auto edge = edges_.at(node_1).find(node_2);
+		if (edge != edges_.at(node_1).end())
+			return edge->second;
+	}
+	return 0;
+}
+
 std::size_t Network::GetDegree(std::size_t node_id) const {
 	if (!ValidateNodeId(node_id))
 		return 0;
@@ -40,6 +40,10 @@ public:
 
 	std::vector<std::size_t> GetNeighbors(std::size_t node_id) const;
 
+	// Returns the weight of the edge between two nodes, or 0 if there is no
+	// such edge.
+	float GetWeight(std::size_t node_1, std::size_t node_2) const;
+
 	std::size_t GetDegree(std::size_t node_id) const;
 
 private:
@@ -6,22 +6,42 @@
 
 #include "NetworkUtils.h"
 
+#include <algorithm>
 #include <queue>
 #include <stack>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using simple_graph::Network;
+using simple_graph::CompactNetwork;
+using simple_graph::BitsetNetwork;
 
 namespace simple_graph {
 namespace utils {
 
-float GetClusteringCoefficient(const Network &network, std::size_t node_id) {
+namespace {
+
+// Computes the clustering coefficient of a node from its degree and the
+// number of edges between its neighbors.
+inline float ClusteringCoefficientFromEdges(std::size_t edge_count,
+		std::size_t degree) {
+	return static_cast<float>(edge_count) * 2.0
+			/ static_cast<float>(degree * (degree - 1));
+}
+
+// The algorithms below are shared by Network and CompactNetwork.
+
+template<typename NetworkType>
+float ClusteringCoefficient(const NetworkType &network, std::size_t node_id) {
 	if (network.Size() <= 2)
 		return 0;
 	std::size_t degree = network.GetDegree(node_id);
 	if (degree < 2)
 		return 0;
 
-	std::vector<std::size_t> neighbors = network.GetNeighbors(node_id);
+	const auto neighbors = network.GetNeighbors(node_id);
 	int edge_count = 0;
 	for (std::size_t i = 0; i < degree; ++i) {
 		// For simple graphs, we only consider undirected ones.
@@ -31,72 +51,282 @@ float GetClusteringCoefficient(const Network &network, std::size_t node_id) {
 				++edge_count;
 		}
 	}
-	return static_cast<float>(edge_count) * 2.0
-			/ static_cast<float>(degree * (degree - 1));
+	return ClusteringCoefficientFromEdges(edge_count, degree);
 }
 
-std::vector<float> GetNodeBetweennessCentrality(const Network &network) {
-	std::size_t network_size = network.Size();
-	std::vector<float> betweenness(network_size, 0.0);
+// The breadth first searches of the betweenness centrality (Brandes). For
+// every source node, SourceDependencies() visits the nodes that are
+// reachable from it and leaves their dependencies on it in
+// workspace.dependency, for the nodes workspace.order[0, num_visited) (the
+// source first). PrepareSearch() sizes the buffers of a workspace for a
+// network first.
 
-	for (std::size_t i = 0; i < network_size; ++i) {
-		// Nodes are stored in the reverse order in which they are visited.
-		std::stack<std::size_t> stack;
-		// Stores the predecessors of each node.
-		std::vector<std::vector<std::size_t>> pre_visit_list(network_size,
-				std::vector<std::size_t>());
-		// A queue for breath first search.
-		std::queue<std::size_t> queue;
-		// Distance from each node to the current node (i). The default is
-		// set to infinity (-1).
-		std::vector<long> distance(network_size, -1);
-		// The number of shortest paths passing through the nodes.
-		std::vector<long> num_path(network_size, 0);
-
-		distance[i] = 0;
-		num_path[i] = 1;
-		queue.push(i);
-		while (!queue.empty()) {
-			const auto node = queue.front();
-			queue.pop();
-			stack.push(node);
+template<typename NetworkType>
+void PrepareSearch(const NetworkType &network, NetworkWorkspace &workspace) {
+	const std::size_t network_size = network.Size();
+	workspace.order.resize(network_size);
+	// Distance from each node to the source. The default is set to infinity
+	// (-1).
+	workspace.distance.assign(network_size, -1);
+	// The number of shortest paths passing through the nodes.
+	workspace.num_path.assign(network_size, 0);
+	workspace.dependency.resize(network_size);
+}
 
-			std::vector<std::size_t> neighbors = network.GetNeighbors(node);
-			for (auto neighbor : neighbors) {
-				if (distance[neighbor] < 0) {
-					queue.push(neighbor);
-					distance[neighbor] = distance[node] + 1;
-				}
+template<typename NetworkType>
+std::size_t SourceDependencies(const NetworkType &network, std::size_t source,
+		NetworkWorkspace &workspace) {
+	// The nodes are visited in breadth first order, so the reverse of order
+	// is the order in which they are popped from a stack.
+	std::vector<std::size_t> &order = workspace.order;
+	std::vector<long> &distance = workspace.distance;
+	std::vector<long> &num_path = workspace.num_path;
+	std::vector<float> &dependency = workspace.dependency;
+	distance[source] = 0;
+	num_path[source] = 1;
+	order[0] = source;
+	std::size_t num_visited = 1;
+	for (std::size_t k = 0; k < num_visited; ++k) {
+		const auto node = order[k];
+		for (auto neighbor : network.GetNeighbors(node)) {
+			if (distance[neighbor] < 0) {
+				order[num_visited++] = neighbor;
+				distance[neighbor] = distance[node] + 1;
+			}
 
-				if (distance[neighbor] == (distance[node] + 1)) {
-					num_path[neighbor] += num_path[node];
-					pre_visit_list.at(neighbor).push_back(node);
-				}
+			if (distance[neighbor] == (distance[node] + 1)) {
+				num_path[neighbor] += num_path[node];
 			}
 		}
+	}
+
+	for (std::size_t k = 0; k < num_visited; ++k) {
+		dependency[order[k]] = 0;
+	}
+	for (std::size_t k = num_visited; k-- > 0;) {
+		const auto cur = order[k];
+		// The predecessors of a node are its neighbors one level closer to
+		// the source.
+		for (auto node : network.GetNeighbors(cur)) {
+			if (distance[node] != distance[cur] - 1)
+				continue;
+			float partial_dep = static_cast<float>(num_path[node])
+					/ num_path[cur] * (1 + dependency[cur]);
+			dependency[node] += partial_dep;
+		}
+	}
+	// Resets the nodes visited by this search.
+	for (std::size_t k = 0; k < num_visited; ++k) {
+		distance[order[k]] = -1;
+		num_path[order[k]] = 0;
+	}
+	return num_visited;
+}
+
+void PrepareSearch(const BitsetNetwork &network, NetworkWorkspace &workspace) {
+	const std::size_t network_size = network.Size();
+	const std::size_t num_words = network.GetNumWords();
+	// The nodes visited by the current search.
+	workspace.visited.resize(num_words);
+	// The nodes of each level of the search, as bitsets.
+	workspace.levels.resize(network_size * num_words);
+	// The nodes in the order in which they are visited. The nodes of level
+	// l are stored in order[level_begin[l], level_begin[l + 1]).
+	workspace.order.resize(network_size);
+	workspace.level_begin.resize(network_size + 1);
+	// The number of shortest paths passing through the nodes.
+	workspace.num_path.assign(network_size, 0);
+	workspace.dependency.assign(network_size, 0);
+}
+
+// The same, using bit-parallel breadth first searches.
+std::size_t SourceDependencies(const BitsetNetwork &network,
+		std::size_t source, NetworkWorkspace &workspace) {
+	typedef BitsetNetwork::Word Word;
+	const std::size_t kWordBits = BitsetNetwork::kWordBits;
+	const std::size_t network_size = network.Size();
+	const std::size_t num_words = network.GetNumWords();
+	std::vector<Word> &visited = workspace.visited;
+	std::vector<Word> &levels = workspace.levels;
+	std::vector<std::size_t> &order = workspace.order;
+	std::vector<std::size_t> &level_begin = workspace.level_begin;
+	std::vector<long> &num_path = workspace.num_path;
+	std::vector<float> &dependency = workspace.dependency;
+
+	std::fill(visited.begin(), visited.end(), 0);
+	visited[source / kWordBits] |= Word(1) << (source % kWordBits);
+	std::fill(levels.begin(), levels.begin() + num_words, 0);
+	levels[source / kWordBits] |= Word(1) << (source % kWordBits);
+	order[0] = source;
+	level_begin[0] = 0;
+	level_begin[1] = 1;
+	num_path[source] = 1;
+	std::size_t num_levels = 1;
+	// The search stops when a level adds no node, or when all nodes have
+	// been visited, so at most network_size levels are stored (e.g. for a
+	// path from one of its ends).
+	while (level_begin[num_levels] < network_size) {
+		// The next level is the union of the neighbors of the current level
+		// that have not been visited yet.
+		const Word *frontier = &levels[(num_levels - 1) * num_words];
+		Word *next = &levels[num_levels * num_words];
+		std::fill(next, next + num_words, 0);
+		for (std::size_t k = level_begin[num_levels - 1];
+				k < level_begin[num_levels]; ++k) {
+			const Word *row = network.GetRow(order[k]);
+			for (std::size_t w = 0; w < num_words; ++w) {
+				next[w] |= row[w];
+			}
+		}
+		Word found = 0;
+		for (std::size_t w = 0; w < num_words; ++w) {
+			next[w] &= ~visited[w];
+			visited[w] |= next[w];
+			found |= next[w];
+		}
+		if (!found)
+			break;
 
-		std::vector<float> dependency(network_size, 0);
-		while (!stack.empty()) {
-			const auto cur = stack.top();
-			stack.pop();
+		// The predecessors of a node are its neighbors in the current level.
+		std::size_t count = level_begin[num_levels];
+		for (std::size_t w = 0; w < num_words; ++w) {
+			for (Word bits = next[w]; bits; bits &= bits - 1) {
+				const std::size_t node = w * kWordBits + __builtin_ctzll(bits);
+				order[count++] = node;
+				const Word *row = network.GetRow(node);
+				long paths = 0;
+				for (std::size_t p = 0; p < num_words; ++p) {
+					for (Word pre = row[p] & frontier[p]; pre;
+							pre &= pre - 1) {
+						paths += num_path[p * kWordBits + __builtin_ctzll(pre)];
+					}
+				}
+				num_path[node] = paths;
+			}
+		}
+		level_begin[++num_levels] = count;
+	}
 
-			for (auto node : pre_visit_list[cur]) {
-				float partial_dep = static_cast<float>(num_path[node])
-						/ num_path[cur] * (1 + dependency[cur]);
-				dependency[node] += partial_dep;
+	// Accumulates the dependencies from the deepest level up. The
+	// dependencies of a level are final once the level below it has been
+	// processed.
+	const std::size_t num_visited = level_begin[num_levels];
+	for (std::size_t k = 0; k < num_visited; ++k) {
+		dependency[order[k]] = 0;
+	}
+	for (std::size_t level = num_levels - 1; level > 0; --level) {
+		const Word *previous = &levels[(level - 1) * num_words];
+		for (std::size_t k = level_begin[level + 1];
+				k-- > level_begin[level];) {
+			const std::size_t cur = order[k];
+			const Word *row = network.GetRow(cur);
+			for (std::size_t w = 0; w < num_words; ++w) {
+				for (Word pre = row[w] & previous[w]; pre; pre &= pre - 1) {
+					const std::size_t node = w * kWordBits
+							+ __builtin_ctzll(pre);
+					float partial_dep = static_cast<float>(num_path[node])
+							/ num_path[cur] * (1 + dependency[cur]);
+					dependency[node] += partial_dep;
+				}
 			}
-			if (cur != i)
-				betweenness[cur] += dependency[cur];
 		}
 	}
+	return num_visited;
+}
+
+void NormalizeBetweenness(std::size_t normalization_size,
+		std::vector<float> &betweenness) {
+	if (normalization_size == 0) {
+		normalization_size = betweenness.size();
+	}
+	for (std::size_t i = 0; i < betweenness.size(); ++i) {
+		betweenness[i] /= (normalization_size - 1) * (normalization_size - 2);
+	}
+}
+
+template<typename NetworkType>
+void NodeBetweennessCentrality(const NetworkType &network,
+		std::size_t normalization_size, NetworkWorkspace &workspace,
+		std::vector<float> &betweenness) {
+	const std::size_t network_size = network.Size();
+	betweenness.assign(network_size, 0.0);
+	PrepareSearch(network, workspace);
 	for (std::size_t i = 0; i < network_size; ++i) {
-		betweenness[i] /= (network_size - 1) * (network_size - 2);
+		const std::size_t num_visited = SourceDependencies(network, i,
+				workspace);
+		for (std::size_t k = 1; k < num_visited; ++k) {
+			const std::size_t node = workspace.order[k];
+			betweenness[node] += workspace.dependency[node];
+		}
 	}
-	return betweenness;
+	NormalizeBetweenness(normalization_size, betweenness);
 }
 
-std::vector<std::vector<std::size_t>> ExtractConnectedComponents(
-		const Network &network) {
+// The number of source nodes per thread of a batch of the parallel
+// betweenness centrality.
+constexpr std::size_t kSourcesPerThread = 16;
+
+// The same, with the source nodes split among the threads. The sources are
+// processed in batches: every thread stores the dependencies on its sources
+// in their rows of workspace.dependencies, and the rows are then added to
+// the betweenness in the order of the sources (by ranges of nodes, in
+// parallel), so the sums are the same as above for any number of threads.
+// workspace.threads must have num_threads workspaces.
+template<typename NetworkType>
+void ParallelNodeBetweennessCentrality(const NetworkType &network,
+		std::size_t normalization_size, int num_threads,
+		ParallelNetworkWorkspace &workspace,
+		std::vector<float> &betweenness) {
+	const std::size_t network_size = network.Size();
+	betweenness.assign(network_size, 0.0);
+	const std::size_t batch_size = std::min(network_size,
+			num_threads * kSourcesPerThread);
+	std::vector<float> &dependencies = workspace.dependencies;
+	dependencies.resize(batch_size * network_size);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads)
+#endif
+	{
+#ifdef _OPENMP
+		NetworkWorkspace &search = workspace.threads[omp_get_thread_num()];
+#else
+		NetworkWorkspace &search = workspace.threads[0];
+#endif
+		PrepareSearch(network, search);
+		for (std::size_t first = 0; first < network_size; first +=
+				batch_size) {
+			const long num_sources = std::min(batch_size,
+					network_size - first);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+			for (long s = 0; s < num_sources; ++s) {
+				float *row = &dependencies[s * network_size];
+				std::fill(row, row + network_size, 0);
+				const std::size_t num_visited = SourceDependencies(network,
+						first + s, search);
+				for (std::size_t k = 1; k < num_visited; ++k) {
+					const std::size_t node = search.order[k];
+					row[node] = search.dependency[node];
+				}
+			}
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+			for (long node = 0; node < static_cast<long>(network_size);
+					++node) {
+				for (long s = 0; s < num_sources; ++s) {
+					betweenness[node] += dependencies[s * network_size + node];
+				}
+			}
+		}
+	}
+	NormalizeBetweenness(normalization_size, betweenness);
+}
+
+template<typename NetworkType>
+std::vector<std::vector<std::size_t>> ConnectedComponents(
+		const NetworkType &network) {
 	std::vector<std::vector<std::size_t>> components;
 
 	std::size_t network_size = network.Size();
@@ -113,8 +343,7 @@ std::vector<std::vector<std::size_t>> ExtractConnectedComponents(
 			std::size_t current = queue.front();
 			queue.pop();
 			component.push_back(current);
-			std::vector<std::size_t> neighbors = network.GetNeighbors(current);
-			for (auto neighbor : neighbors) {
+			for (auto neighbor : network.GetNeighbors(current)) {
 				if (!visited[neighbor]) {
 					queue.push(neighbor);
 					visited[neighbor] = true;
@@ -126,24 +355,274 @@ std::vector<std::vector<std::size_t>> ExtractConnectedComponents(
 	return components;
 }
 
-std::vector<std::size_t> ExtractGiantComponent(const Network &network) {
-	std::vector<std::vector<std::size_t>> components =
-			ExtractConnectedComponents(network);
-	if (components.empty())
-		return std::vector<std::size_t>();
+template<typename NetworkType>
+void GiantComponent(const NetworkType &network, NetworkWorkspace &workspace,
+		std::vector<std::size_t> &giant_component) {
+	std::size_t network_size = network.Size();
+	// The components are visited one after another, from the smallest
+	// node_id that is not visited yet, so they are stored in order
+	// contiguously.
+	std::vector<std::size_t> &order = workspace.order;
+	std::vector<long> &visited = workspace.distance;
+	order.resize(network_size);
+	visited.assign(network_size, 0);
+
+	std::size_t num_visited = 0, num_components = 0;
+	std::size_t giant_begin = 0, giant_size = 0;
+	for (std::size_t i = 0; i < network_size; ++i) {
+		if (visited[i])
+			continue;
+		const std::size_t begin = num_visited;
+		order[num_visited++] = i;
+		visited[i] = 1;
+		for (std::size_t k = begin; k < num_visited; ++k) {
+			for (auto neighbor : network.GetNeighbors(order[k])) {
+				if (!visited[neighbor]) {
+					order[num_visited++] = neighbor;
+					visited[neighbor] = 1;
+				}
+			}
+		}
+		// The first component is only selected if it is the only one.
+		const std::size_t size = num_visited - begin;
+		if (num_components == 0 || size > giant_size) {
+			giant_begin = begin;
+			giant_size = num_components == 0 ? 0 : size;
+		}
+		++num_components;
+	}
+	if (num_components == 1) {
+		giant_size = num_visited;
+	}
+	giant_component.assign(order.begin() + giant_begin,
+			order.begin() + giant_begin + giant_size);
+}
+
+} /* namespace */
+
+float GetClusteringCoefficient(const Network &network, std::size_t node_id) {
+	return ClusteringCoefficient(network, node_id);
+}
+
+float GetClusteringCoefficient(const CompactNetwork &network,
+		std::size_t node_id) {
+	return ClusteringCoefficient(network, node_id);
+}
+
+std::vector<float> GetAllClusteringCoefficients(const Network &network) {
+	if (network.Size() <= kMaxBitsetBetweennessSize)
+		return GetAllClusteringCoefficients(BitsetNetwork(network));
+	return GetAllClusteringCoefficients(CompactNetwork(network));
+}
+
+std::vector<float> GetAllClusteringCoefficients(
+		const CompactNetwork &network) {
+	std::vector<float> clustering;
+	GetAllClusteringCoefficients(network, clustering);
+	return clustering;
+}
 
-	std::size_t giant_size = 0, giant_index = 0;
-	for (std::size_t i = 1; i < components.size(); ++i) {
-		if (components.at(i).size() > giant_size) {
-			giant_size = components.at(i).size();
-			giant_index = i;
+std::vector<float> GetAllClusteringCoefficients(
+		const BitsetNetwork &network) {
+	std::vector<float> clustering;
+	GetAllClusteringCoefficients(network, clustering);
+	return clustering;
+}
+
+void GetAllClusteringCoefficients(const CompactNetwork &network,
+		std::vector<float> &clustering) {
+	const std::size_t network_size = network.Size();
+	clustering.assign(network_size, 0);
+	if (network_size <= 2)
+		return;
+	for (std::size_t i = 0; i < network_size; ++i) {
+		const std::size_t degree = network.GetDegree(i);
+		if (degree < 2)
+			continue;
+		const auto neighbors = network.GetNeighbors(i);
+		// Each edge between two neighbors is found from both ends.
+		std::size_t twice_edge_count = 0;
+		for (auto neighbor : neighbors) {
+			if (neighbor == i)
+				continue;
+			const auto common = network.GetNeighbors(neighbor);
+			auto first = neighbors.begin(), second = common.begin();
+			while (first != neighbors.end() && second != common.end()) {
+				if (*first < *second) {
+					++first;
+				} else if (*second < *first) {
+					++second;
+				} else {
+					if (*first != i && *first != neighbor)
+						++twice_edge_count;
+					++first;
+					++second;
+				}
+			}
 		}
+		clustering[i] = ClusteringCoefficientFromEdges(twice_edge_count / 2,
+				degree);
+	}
+}
+
+void GetAllClusteringCoefficients(const BitsetNetwork &network,
+		std::vector<float> &clustering) {
+	typedef BitsetNetwork::Word Word;
+	const std::size_t kWordBits = BitsetNetwork::kWordBits;
+	const std::size_t network_size = network.Size();
+	const std::size_t num_words = network.GetNumWords();
+	clustering.assign(network_size, 0);
+	if (network_size <= 2)
+		return;
+	for (std::size_t i = 0; i < network_size; ++i) {
+		const std::size_t degree = network.GetDegree(i);
+		if (degree < 2)
+			continue;
+		const Word *row = network.GetRow(i);
+		const Word self = Word(1) << (i % kWordBits);
+		// Each edge between two neighbors is found from both ends.
+		std::size_t twice_edge_count = 0;
+		for (std::size_t w = 0; w < num_words; ++w) {
+			for (Word bits = row[w]; bits; bits &= bits - 1) {
+				const std::size_t neighbor = w * kWordBits
+						+ __builtin_ctzll(bits);
+				if (neighbor == i)
+					continue;
+				const Word *neighbor_row = network.GetRow(neighbor);
+				for (std::size_t k = 0; k < num_words; ++k) {
+					Word common = row[k] & neighbor_row[k];
+					if (k == i / kWordBits)
+						common &= ~self;
+					if (k == neighbor / kWordBits)
+						common &= ~(Word(1) << (neighbor % kWordBits));
+					twice_edge_count += __builtin_popcountll(common);
+				}
+			}
+		}
+		clustering[i] = ClusteringCoefficientFromEdges(twice_edge_count / 2,
+				degree);
+	}
+}
+
+std::vector<float> GetNodeBetweennessCentrality(const Network &network,
+		std::size_t normalization_size) {
+	NetworkWorkspace workspace;
+	std::vector<float> betweenness;
+	if (UsesBitsetBetweenness(network.Size(), normalization_size)) {
+		GetNodeBetweennessCentrality(BitsetNetwork(network),
+				normalization_size, workspace, betweenness);
+	} else {
+		NodeBetweennessCentrality(network, normalization_size, workspace,
+				betweenness);
+	}
+	return betweenness;
+}
+
+std::vector<float> GetNodeBetweennessCentrality(
+		const CompactNetwork &network, std::size_t normalization_size) {
+	NetworkWorkspace workspace;
+	std::vector<float> betweenness;
+	GetNodeBetweennessCentrality(network, normalization_size, workspace,
+			betweenness);
+	return betweenness;
+}
+
+std::vector<float> GetNodeBetweennessCentrality(
+		const BitsetNetwork &network, std::size_t normalization_size) {
+	NetworkWorkspace workspace;
+	std::vector<float> betweenness;
+	GetNodeBetweennessCentrality(network, normalization_size, workspace,
+			betweenness);
+	return betweenness;
+}
+
+void GetNodeBetweennessCentrality(const CompactNetwork &network,
+		std::size_t normalization_size, NetworkWorkspace &workspace,
+		std::vector<float> &betweenness) {
+	if (UsesBitsetBetweenness(network.Size(), normalization_size)) {
+		workspace.adjacency.Assign(network);
+		GetNodeBetweennessCentrality(workspace.adjacency, normalization_size,
+				workspace, betweenness);
+	} else {
+		NodeBetweennessCentrality(network, normalization_size, workspace,
+				betweenness);
 	}
+}
 
-	return components[giant_index];
+void GetNodeBetweennessCentrality(const BitsetNetwork &network,
+		std::size_t normalization_size, NetworkWorkspace &workspace,
+		std::vector<float> &betweenness) {
+	NodeBetweennessCentrality(network, normalization_size, workspace,
+			betweenness);
+}
+
+std::vector<float> GetNodeBetweennessCentrality(
+		const CompactNetwork &network, std::size_t normalization_size,
+		int num_threads) {
+	ParallelNetworkWorkspace workspace;
+	std::vector<float> betweenness;
+	GetNodeBetweennessCentrality(network, normalization_size, num_threads,
+			workspace, betweenness);
+	return betweenness;
+}
+
+void GetNodeBetweennessCentrality(const CompactNetwork &network,
+		std::size_t normalization_size, int num_threads,
+		ParallelNetworkWorkspace &workspace,
+		std::vector<float> &betweenness) {
+#ifndef _OPENMP
+	num_threads = 1;
+#endif
+	num_threads = std::max(num_threads, 1);
+	if (workspace.threads.size() < static_cast<std::size_t>(num_threads)) {
+		workspace.threads.resize(num_threads);
+	}
+	if (UsesBitsetBetweenness(network.Size(), normalization_size)) {
+		BitsetNetwork &adjacency = workspace.threads[0].adjacency;
+		adjacency.Assign(network);
+		ParallelNodeBetweennessCentrality(adjacency, normalization_size,
+				num_threads, workspace, betweenness);
+	} else {
+		ParallelNodeBetweennessCentrality(network, normalization_size,
+				num_threads, workspace, betweenness);
+	}
+}
+
+std::vector<std::vector<std::size_t>> ExtractConnectedComponents(
+		const Network &network) {
+	return ConnectedComponents(network);
+}
+
+std::vector<std::vector<std::size_t>> ExtractConnectedComponents(
+		const CompactNetwork &network) {
+	return ConnectedComponents(network);
+}
+
+std::vector<std::size_t> ExtractGiantComponent(const Network &network) {
+	NetworkWorkspace workspace;
+	std::vector<std::size_t> giant_component;
+	GiantComponent(network, workspace, giant_component);
+	return giant_component;
+}
+
+std::vector<std::size_t> ExtractGiantComponent(
+		const CompactNetwork &network) {
+	NetworkWorkspace workspace;
+	std::vector<std::size_t> giant_component;
+	GiantComponent(network, workspace, giant_component);
+	return giant_component;
+}
+
+void ExtractGiantComponent(const CompactNetwork &network,
+		NetworkWorkspace &workspace, std::vector<std::size_t> &giant_component) {
+	GiantComponent(network, workspace, giant_component);
 }
 
 UnionFind::UnionFind(std::size_t size) {
+  Reset(size);
+}
+
+void UnionFind::Reset(std::size_t size) {
   parents_.resize(size);
   component_size_.resize(size);
   for (std::size_t i = 0; i < size; ++i) {
@@ -8,28 +8,141 @@
 #define SIMPLEGRAPH_NETWORKUTILS_H_
 
 #include "Network.h"
+#include "CompactNetwork.h"
+#include "BitsetNetwork.h"
 
+#include <algorithm>
 #include <vector>
 
 namespace simple_graph {
 namespace utils {
 
+// The functions below accept both Network and CompactNetwork. The latter
+// is faster since iterating over neighbors does not allocate.
+
+// The buffers of the breadth first searches of the functions below. The
+// overloads that take a workspace reuse its memory (e.g. one workspace per
+// thread, from network to network), so they do not allocate once the buffers
+// are large enough. Only the entries of the nodes visited by a search are
+// reset after it.
+struct NetworkWorkspace {
+	// The nodes in the order in which they are visited.
+	std::vector<std::size_t> order;
+	// The distance of each node to the source (-1 if not visited yet), the
+	// number of shortest paths to it and its dependency.
+	std::vector<long> distance;
+	std::vector<long> num_path;
+	std::vector<float> dependency;
+	// The buffers of the bit-parallel betweenness centrality: the visited
+	// nodes and the nodes of each level as bitsets, and the first visited
+	// node of each level.
+	std::vector<BitsetNetwork::Word> visited;
+	std::vector<BitsetNetwork::Word> levels;
+	std::vector<std::size_t> level_begin;
+	// The adjacency matrix of the network being analyzed, for the callers
+	// that use the bit-parallel functions.
+	BitsetNetwork adjacency;
+};
+
+// The buffers of the parallel betweenness centrality: the workspace of each
+// thread and the dependencies of the nodes on a batch of source nodes.
+struct ParallelNetworkWorkspace {
+	std::vector<NetworkWorkspace> threads;
+	std::vector<float> dependencies;
+};
+
 float GetClusteringCoefficient(const simple_graph::Network &network,
 		std::size_t node_id);
+float GetClusteringCoefficient(const simple_graph::CompactNetwork &network,
+		std::size_t node_id);
+
+// Returns the clustering coefficients of all nodes, in the order of the
+// node_id. The triangles of all nodes are counted in one pass: with
+// intersections of adjacency rows (popcount) for BitsetNetwork and with
+// merges of the sorted neighbor lists for CompactNetwork. The values are the
+// same as GetClusteringCoefficient() for graphs without self loops.
+std::vector<float> GetAllClusteringCoefficients(
+		const simple_graph::Network &network);
+std::vector<float> GetAllClusteringCoefficients(
+		const simple_graph::CompactNetwork &network);
+std::vector<float> GetAllClusteringCoefficients(
+		const simple_graph::BitsetNetwork &network);
+// The same, into clustering, reusing its memory.
+void GetAllClusteringCoefficients(const simple_graph::CompactNetwork &network,
+		std::vector<float> &clustering);
+void GetAllClusteringCoefficients(const simple_graph::BitsetNetwork &network,
+		std::vector<float> &clustering);
+
+// Networks up to this size use the bit-parallel betweenness centrality.
+constexpr std::size_t kMaxBitsetBetweennessSize = 512;
+
+// Whether the betweenness centrality of a network of network_size nodes,
+// normalized for normalization_size nodes (see below), is computed with the
+// bit-parallel algorithm.
+inline bool UsesBitsetBetweenness(std::size_t network_size,
+		std::size_t normalization_size) {
+	return std::max(network_size, normalization_size)
+			<= kMaxBitsetBetweennessSize;
+}
 
 // Returns a vector of the node betweenness centrality. The order is the
-// same as the node_id.
+// same as the node_id. The centrality is normalized by the number of node
+// pairs of a network of normalization_size nodes (network.Size() if 0),
+// e.g. of the larger network that the given one is a part of, apart from
+// isolated nodes. If that network has at most kMaxBitsetBetweennessSize
+// nodes, the network is converted to a BitsetNetwork first. The algorithm
+// only depends on the larger network, since the two sum the dependencies in
+// different orders, so a part of it gets the same (bitwise) results.
 std::vector<float> GetNodeBetweennessCentrality(
-		const simple_graph::Network &network);
+		const simple_graph::Network &network,
+		std::size_t normalization_size = 0);
+std::vector<float> GetNodeBetweennessCentrality(
+		const simple_graph::CompactNetwork &network,
+		std::size_t normalization_size = 0);
+// The same as above, using bit-parallel breadth first searches: each level
+// of the search is expanded with word-wide AND/OR over the adjacency rows,
+// and the shortest path counts and dependencies are accumulated level by
+// level in flat buffers reused for all source nodes. The results match the
+// queue based implementation up to float rounding.
+std::vector<float> GetNodeBetweennessCentrality(
+		const simple_graph::BitsetNetwork &network,
+		std::size_t normalization_size = 0);
+// The same, into betweenness, with the buffers of the workspace. The
+// CompactNetwork overload converts small networks into workspace.adjacency.
+void GetNodeBetweennessCentrality(const simple_graph::CompactNetwork &network,
+		std::size_t normalization_size, NetworkWorkspace &workspace,
+		std::vector<float> &betweenness);
+void GetNodeBetweennessCentrality(const simple_graph::BitsetNetwork &network,
+		std::size_t normalization_size, NetworkWorkspace &workspace,
+		std::vector<float> &betweenness);
+// The same, for a single large network: the source nodes of the breadth
+// first searches are split among num_threads OpenMP threads, which
+// accumulate their dependencies separately. The dependencies are summed in
+// the order of the source nodes, so the results are identical to the
+// functions above for any number of threads. Small networks are converted
+// into workspace.threads[0].adjacency.
+std::vector<float> GetNodeBetweennessCentrality(
+		const simple_graph::CompactNetwork &network,
+		std::size_t normalization_size, int num_threads);
+void GetNodeBetweennessCentrality(const simple_graph::CompactNetwork &network,
+		std::size_t normalization_size, int num_threads,
+		ParallelNetworkWorkspace &workspace, std::vector<float> &betweenness);
 
 // Returns a lit of nodes in the connected components.
 std::vector<std::vector<std::size_t>> ExtractConnectedComponents(
 		const simple_graph::Network &network);
+std::vector<std::vector<std::size_t>> ExtractConnectedComponents(
+		const simple_graph::CompactNetwork &network);
 
 // Returns a lit of nodes in the giant component (a.k.a. the largest
 // connected component).
 std::vector<std::size_t> ExtractGiantComponent(
 		const simple_graph::Network &network);
+std::vector<std::size_t> ExtractGiantComponent(
+		const simple_graph::CompactNetwork &network);
+// The same, into giant_component, with the buffers of the workspace.
+void ExtractGiantComponent(const simple_graph::CompactNetwork &network,
+		NetworkWorkspace &workspace, std::vector<std::size_t> &giant_component);
 
 // Returns the index of the element with the largest moving average.
 template<typename T>
@@ -41,6 +154,8 @@ public:
 	UnionFind(std::size_t size);
 	~UnionFind() {
 	}
+	// Separates size nodes again, reusing the memory of the structure.
+	void Reset(std::size_t size);
 	void Union(std::size_t node1, std::size_t node2);
 	inline bool IsConnected(std::size_t node1, std::size_t node2) {
 		return ValidateNode(node1) && (FindRoot(node1) == FindRoot(node2));
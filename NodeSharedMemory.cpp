@@ -0,0 +1,86 @@
+/*
+ * NodeSharedMemory.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "NodeSharedMemory.h"
+
+#include <iostream>
+
+namespace remote_sensing {
+
+NodeSharedMemory::NodeSharedMemory() :
+		node_communicator_(MPI_COMM_NULL), window_(MPI_WIN_NULL), memory_(
+				nullptr), node_rank_(0), node_size_(0) {
+}
+
+NodeSharedMemory::~NodeSharedMemory() {
+	Free();
+}
+
+bool NodeSharedMemory::Allocate(MPI_Comm communicator, std::size_t size) {
+	Free();
+	int rank;
+	MPI_Comm_rank(communicator, &rank);
+	if (MPI_Comm_split_type(communicator, MPI_COMM_TYPE_SHARED, rank,
+			MPI_INFO_NULL, &node_communicator_) != MPI_SUCCESS) {
+		node_communicator_ = MPI_COMM_NULL;
+		return false;
+	}
+	MPI_Comm_rank(node_communicator_, &node_rank_);
+	MPI_Comm_size(node_communicator_, &node_size_);
+	if (MPI_Win_allocate_shared(size, 1, MPI_INFO_NULL, node_communicator_,
+			&memory_, &window_) != MPI_SUCCESS) {
+		std::cerr << "cannot allocate " << size
+				<< " bytes of node-shared memory" << std::endl;
+		window_ = MPI_WIN_NULL;
+		memory_ = nullptr;
+		Free();
+		return false;
+	}
+	// The window stays in a passive target epoch so that Synchronize() can
+	// use MPI_Win_sync.
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, window_);
+	return true;
+}
+
+void NodeSharedMemory::Free() {
+	if (window_ != MPI_WIN_NULL) {
+		MPI_Win_unlock_all(window_);
+		MPI_Win_free(&window_);
+	}
+	if (node_communicator_ != MPI_COMM_NULL) {
+		MPI_Comm_free(&node_communicator_);
+	}
+	window_ = MPI_WIN_NULL;
+	node_communicator_ = MPI_COMM_NULL;
+	memory_ = nullptr;
+	node_rank_ = 0;
+	node_size_ = 0;
+}
+
+void NodeSharedMemory::Synchronize() {
+	if (window_ == MPI_WIN_NULL) {
+		return;
+	}
+	MPI_Win_sync(window_);
+	MPI_Barrier(node_communicator_);
+	MPI_Win_sync(window_);
+}
+
+void* NodeSharedMemory::GetTaskMemory(int node_rank, std::size_t &size) const {
+	size = 0;
+	if (window_ == MPI_WIN_NULL || node_rank < 0 || node_rank >= node_size_) {
+		return nullptr;
+	}
+	MPI_Aint task_size;
+	int displacement_unit;
+	void *memory;
+	MPI_Win_shared_query(window_, node_rank, &task_size, &displacement_unit,
+			&memory);
+	size = task_size;
+	return memory;
+}
+
+} /* namespace remote_sensing */
@@ -0,0 +1,73 @@
+/*
+ * NodeSharedMemory.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_PHENONET_NODESHAREDMEMORY_H_
+#define SIMPLEGRAPH_PHENONET_NODESHAREDMEMORY_H_
+
+#include <mpi.h>
+#include <cstddef>
+
+namespace remote_sensing {
+
+/*
+ * Memory shared by the tasks of a communicator that run on the same node,
+ * allocated with MPI_Win_allocate_shared. Each task allocates its own part,
+ * and the parts of a node are contiguous in the order of the ranks, so any
+ * task (or thread) of the node can read the data of the others without
+ * copies.
+ */
+class NodeSharedMemory {
+public:
+	NodeSharedMemory();
+	virtual ~NodeSharedMemory();
+	NodeSharedMemory(const NodeSharedMemory &other) = delete;
+	NodeSharedMemory& operator=(const NodeSharedMemory &other) = delete;
+
+	// Splits the communicator into nodes with MPI_Comm_split_type and
+	// allocates size bytes for this task, freeing any previous memory. This
+	// is collective over the communicator. Returns false on failure.
+	bool Allocate(MPI_Comm communicator, std::size_t size);
+
+	void Free();
+
+	// Makes the writes of all tasks of the node visible to each other. This
+	// is collective over the node.
+	void Synchronize();
+
+	// The memory of this task.
+	inline void* GetMemory() const {
+		return memory_;
+	}
+
+	// The memory of a task of the node and its size, by its rank in the
+	// node communicator.
+	void* GetTaskMemory(int node_rank, std::size_t &size) const;
+
+	// The tasks of the communicator on the node of this task, in the order
+	// of their ranks in the communicator.
+	inline MPI_Comm GetNodeCommunicator() const {
+		return node_communicator_;
+	}
+
+	inline int GetNodeRank() const {
+		return node_rank_;
+	}
+
+	inline int GetNodeSize() const {
+		return node_size_;
+	}
+
+private:
+	MPI_Comm node_communicator_;
+	MPI_Win window_;
+	void *memory_;
+	int node_rank_;
+	int node_size_;
+};
+
+} /* namespace remote_sensing */
+
+#endif /* SIMPLEGRAPH_PHENONET_NODESHAREDMEMORY_H_ */
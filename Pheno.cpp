@@ -5,31 +5,46 @@
 //============================================================================
 
 #include "PhenoNet.h"
+#include "PixelBlock.h"
+#include "SpaceTimeDecomposition.h"
+#include "TextLoader.h"
+#include "TileCube.h"
 #include "TimeSeries.h"
 #include "TimeSeriesDecomposition.h"
 #include "Utils.h"
+#include "WorkStealingScheduler.h"
 
 #include <mpi.h>
-#include <math.h>
+#include <algorithm>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <string>
 #include <vector>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 using namespace remote_sensing;
 
-// These hard coded functions prepare the example data for demo purpose.
-void AssignTasks(int num_time_slices, int num_pixels, int num_tasks,
-		 int num_task_per_node, vector<int> &time_slice_index_to_task,
-		 utils::DecompositionSchema &schema);
-
-bool GetExampleData(int num_bands, int num_pixels, int rank,
-		    const vector<int> &time_slice_index_to_task,
-		    vector<vector<float*>> &data);
+// This hard coded function prepares the example data for demo purpose.
+// Reads the bands of the pixels [first_pixel, first_pixel + num_pixels) of
+// one day of the example data.
+bool ReadExampleTimeSlice(int time_slice_index, int first_pixel,
+			  int num_pixels, const vector<float*> &bands);
 
-void CleanUp(vector<vector<float*>> &data);
+// Finds the peaks of the pixels of this task, balancing the chunks of
+// num_pixels_per_chunk pixels between the tasks of the communicator.
+// Quantized time series (int16_t, uint16_t) are analyzed without decoding
+// them.
+template<typename T>
+bool FindPeaks(vector<TimeSeries<T>> &&time_series,
+	       const BandQuantization &quantization, int num_pixels_per_chunk,
+	       double min_giant_fraction, int num_threads, MPI_Comm communicator,
+	       vector<int> &peaks);
 
+// Usage: pheno [cube]. Reads the example text data, or the tile cube made
+// from it by convert_cube if given.
 int main(int argc, char* argv[]) {
   const int num_bands = 7;
   const int num_pixels = 114;
@@ -37,133 +52,208 @@ int main(int argc, char* argv[]) {
   const int root = 0;
   const double min_giant_fraction = 0.8;
   const int num_task_per_node = 4;
+  // The image is divided into tiles, which are shared by the node groups.
+  const int num_tiles = 2;
+  const int num_node_groups = 2;
+  // The number of time slices that are distributed together while the next
+  // ones are being read.
+  const int num_time_slices_per_chunk = 16;
+  // The pixels are processed in chunks, which idle tasks steal from busy
+  // ones since the cost per pixel varies a lot. Each chunk is analyzed by
+  // all threads of a task, which PhenoNet hands groups of
+  // InterleavedPixelBlock::kLanes pixels to, so a chunk holds this many
+  // groups per thread.
+  const int num_groups_per_thread = 1;
+  // The number of threads used by each task to process its pixels. 0 uses
+  // the OpenMP default (OMP_NUM_THREADS or all cores).
+  int num_threads = 0;
 
-  int size, rank;
-  MPI_Init(&argc, &argv);
+  int size, rank, thread_support;
+  // Only the main thread makes MPI calls.
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
   MPI_Comm_size(MPI_COMM_WORLD, &size);
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
-  utils::DecompositionSchema schema(size, root);
-  
-  vector<int> time_slice_index_to_task(num_time_slices, root);
-  AssignTasks(num_time_slices, num_pixels, size, num_task_per_node,
-	      time_slice_index_to_task, schema);
-
-  vector<vector<float*>> example_data(num_time_slices,
-				      vector<float*>(num_bands, nullptr));
-  if (!GetExampleData(num_bands, num_pixels, rank, time_slice_index_to_task,
-		      example_data)) {
-    cerr << "Encountered error(s) while processing the example data "
-	 << "for task #" << rank << endl;
-    CleanUp(example_data);
+  if (thread_support < MPI_THREAD_FUNNELED) {
+    // The MPI library does not allow threads at all, so the pixels are
+    // processed by the main thread only.
+    if (rank == root) {
+      cerr << "MPI_THREAD_FUNNELED is not supported, using one thread per "
+	   << "task." << endl;
+    }
+    num_threads = 1;
+  }
+  // Smaller chunks would leave threads idle: a chunk of a single group is
+  // analyzed by one thread.
+  int num_chunk_threads = num_threads;
+#ifdef _OPENMP
+  if (num_chunk_threads == 0) {
+    num_chunk_threads = omp_get_max_threads();
+  }
+#endif
+  const int num_pixels_per_chunk = InterleavedPixelBlock::kLanes
+    * max(num_chunk_threads, 1) * num_groups_per_thread;
+  const string cube_path = argc > 1 ? argv[1] : "";
+  // Quantized cubes are distributed and analyzed as stored.
+  TileCubeInfo cube_info;
+  cube_info.data_type = CubeDataType::kFloat32;
+  if (!cube_path.empty() && !TileCube::ReadInfo(cube_path, cube_info)) {
     MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
   }
 
-  TimeSeriesDecomposition<float> time_series_distributor(
-							 time_slice_index_to_task, example_data, num_bands, num_pixels,
-							 schema, rank);
-  if (!time_series_distributor.DistributeData()) {
-    if (rank == root)
-      std::cerr << "Encountered errors while distributing the data.\n";
-    CleanUp(example_data);
-    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  // The pixels of this task and their peaks.
+  vector<int> pixels, peaks;
+  {
+    // The node groups work on their tiles independently: all the data of
+    // a tile is exchanged within the group communicator.
+    SpaceTimeDecomposition decomposition(num_pixels, num_time_slices,
+					 num_tiles, num_task_per_node);
+    if (!decomposition.Plan(MPI_COMM_WORLD, num_node_groups)) {
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    const int group_rank = decomposition.GetGroupRank();
+    for (const auto &tile : decomposition.GetTiles()) {
+      const MPI_Comm group_communicator = decomposition.GetGroupCommunicator();
+      // Each task reads its sub-tile straight from the cube.
+      const int task_first_pixel = tile.first_pixel
+	+ tile.schema.displacements[group_rank];
+      const int task_num_pixels = tile.schema.counts[group_rank];
+      vector<int> peak_index;
+      bool succeeded = false;
+      BandQuantization quantization;
+      if (cube_info.data_type == CubeDataType::kInt16) {
+	vector<TimeSeries<int16_t>> time_series;
+	succeeded = TileCube::Read(group_communicator, cube_path,
+				   task_first_pixel, task_num_pixels,
+				   time_series, quantization)
+	  && FindPeaks(std::move(time_series), quantization,
+		       num_pixels_per_chunk, min_giant_fraction, num_threads,
+		       group_communicator, peak_index);
+      } else if (cube_info.data_type == CubeDataType::kUInt16) {
+	vector<TimeSeries<uint16_t>> time_series;
+	succeeded = TileCube::Read(group_communicator, cube_path,
+				   task_first_pixel, task_num_pixels,
+				   time_series, quantization)
+	  && FindPeaks(std::move(time_series), quantization,
+		       num_pixels_per_chunk, min_giant_fraction, num_threads,
+		       group_communicator, peak_index);
+      } else if (!cube_path.empty()) {
+	vector<TimeSeries<float>> time_series;
+	succeeded = TileCube::Read(group_communicator, cube_path,
+				   task_first_pixel, task_num_pixels,
+				   time_series)
+	  && FindPeaks(std::move(time_series), quantization,
+		       num_pixels_per_chunk, min_giant_fraction, num_threads,
+		       group_communicator, peak_index);
+      } else {
+	// Each task reads its days of the tile while the previous ones are
+	// being distributed.
+	TimeSeriesDecomposition<float> time_series_distributor(
+							       tile.time_slice_index_to_task, num_bands, tile.num_pixels,
+							       tile.schema, group_rank, group_communicator);
+	// The tasks of a node share one copy of their pixels, which is
+	// processed in place: the time series are views of it, so the
+	// distributor outlives their analysis.
+	time_series_distributor.SetSharedMemory(true);
+	auto read_time_slice = [&tile](int time_slice_index,
+				       const vector<float*> &bands) {
+	  return ReadExampleTimeSlice(time_slice_index, tile.first_pixel,
+				      tile.num_pixels, bands);
+	};
+	if (time_series_distributor.DistributeData(read_time_slice,
+						   num_time_slices_per_chunk)) {
+	  succeeded = FindPeaks(time_series_distributor.GetTimeSeries(),
+				quantization, num_pixels_per_chunk,
+				min_giant_fraction, num_threads,
+				group_communicator, peak_index);
+	} else if (group_rank == tile.schema.root) {
+	  std::cerr << "Encountered errors while distributing the data.\n";
+	}
+      }
+      if (!succeeded) {
+	MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+      }
+      for (size_t i = 0; i < peak_index.size(); ++i) {
+	pixels.push_back(tile.first_pixel
+			 + tile.schema.displacements[group_rank] + i);
+	peaks.push_back(peak_index[i]);
+      }
+    }
   }
 
-  vector<TimeSeries<float>> time_series =
-    time_series_distributor.GetTimeSeries();
-  PhenoNet pheno_net(std::move(time_series), min_giant_fraction);
-  pheno_net.Process();
-  const auto peak_index = pheno_net.GetPeakTimeSliceIndex();
-  
-  int *global_peak_index =
-    rank == root ? new int[num_time_slices] : nullptr;
-  MPI_Gatherv(peak_index.data(), schema.counts[rank], MPI_INT,
-	      global_peak_index, schema.counts.data(), schema.displacements.data(),
-	      MPI_INT, root, MPI_COMM_WORLD);
+  // Collects the peaks of all pixels at the root for printing.
+  int num_task_pixels = static_cast<int>(pixels.size());
+  vector<int> counts(size), displacements(size, 0);
+  MPI_Gather(&num_task_pixels, 1, MPI_INT, counts.data(), 1, MPI_INT, root,
+	     MPI_COMM_WORLD);
+  for (int i = 1; i < size; ++i) {
+    displacements[i] = displacements[i - 1] + counts[i - 1];
+  }
+  vector<int> all_pixels(num_pixels), all_peaks(num_pixels);
+  MPI_Gatherv(pixels.data(), num_task_pixels, MPI_INT, all_pixels.data(),
+	      counts.data(), displacements.data(), MPI_INT, root,
+	      MPI_COMM_WORLD);
+  MPI_Gatherv(peaks.data(), num_task_pixels, MPI_INT, all_peaks.data(),
+	      counts.data(), displacements.data(), MPI_INT, root,
+	      MPI_COMM_WORLD);
   
   if (rank == root) {
+    vector<int> global_peak_index(num_pixels);
+    for (int i = 0; i < num_pixels; ++i) {
+      global_peak_index[all_pixels[i]] = all_peaks[i];
+    }
     for (int i = 0; i < num_pixels; ++i) {
       cout << "pixel #" << i << " peak: " << (global_peak_index[i])
 	   << endl;
     }
-    delete global_peak_index;
   }
 
-  CleanUp(example_data);
   MPI_Finalize();
   return 0;
 }
 
-// For demo purpose, only parallel on the time slices.
-void AssignTasks(int num_time_slices, int num_pixels, int num_tasks,
-		int num_task_per_node, vector<int> &time_slice_index_to_task,
-		utils::DecompositionSchema &schema) {
-  const int num_nodes = ceil(static_cast<float>(num_tasks) / num_task_per_node);
-  time_slice_index_to_task.resize(num_time_slices, 0);
-  for (int i = 0; i < num_time_slices; ++i) {
-    time_slice_index_to_task[i] = i % num_nodes * num_task_per_node;
-  }
-  const int num_pixels_per_task = num_pixels / num_tasks;
-  int unassigned_pixels = num_pixels % num_tasks;
-  schema.counts.resize(num_tasks,  num_pixels_per_task);
-  schema.displacements.resize(num_tasks, 0);
-  for (int i = 0; i < num_tasks; ++i) {
-    if (unassigned_pixels > 0) {
-      ++schema.counts[i];
-      --unassigned_pixels;
-    }
-    if (i > 0) {
-      schema.displacements[i] = schema.displacements[i - 1]
-	+ schema.counts[i - 1];
-    }
-  }
+bool ReadExampleTimeSlice(int time_slice_index, int first_pixel,
+			  int num_pixels, const vector<float*> &bands) {
+  const string input_path = "./test_data/day_" + to_string(time_slice_index + 1)
+    + ".txt";
+  return TextLoader::LoadTimeSlice(input_path, first_pixel, num_pixels, bands);
 }
 
-bool GetExampleData(int num_bands, int num_pixels,
-		    int rank, const vector<int> &time_slice_index_to_task,
-		    vector<vector<float*>> &data) {
-  const int num_time_slices =
-    static_cast<int>(time_slice_index_to_task.size());
-  for (int i = 0; i < num_time_slices; i++) {
-    if (time_slice_index_to_task[i] != rank) {
-      continue;
-    }
-    const string input_path = "./test_data/day_" + to_string(i + 1)
-      + ".txt";
-    ifstream in(input_path.c_str(), ifstream::in);
-    if (!in) {
-      cerr << "Cannot open the input data. "
-	   << "Please check if the file exists: " << input_path
-	   << endl;
-      CleanUp(data);
-      return false;
-    }
-    for (int j = 0; j < num_bands; ++j) {
-      data[i][j] = new float[num_pixels];
-    }
-    string line;
-    for (int j = 0; j < num_pixels; ++j) {
-      getline(in, line);
-      istringstream iss(line);
-      for (int band = 0; band < num_bands;
-	   ++band) {
-	float reflectance = 0;
-	iss >> reflectance;
-	data[i][band][j] = reflectance;
-      }
-    }
-    in.close();
-  }
-  return true;
+// Analyzes the pixels of one chunk.
+vector<int> FindChunkPeaks(PhenoNet &pheno_net, int num_threads) {
+  pheno_net.SetNumThreads(num_threads);
+  pheno_net.Process();
+  return pheno_net.GetPeakTimeSliceIndex();
 }
 
-void CleanUp(vector<vector<float*>> &data) {
-  for (auto &row : data) {
-    for (auto &cell : row) {
-      if (cell) {
-	delete cell;
-	cell = nullptr;
-      }
-    }
+vector<int> FindChunkPeaks(vector<TimeSeries<float>> &&time_series,
+			   const BandQuantization &quantization,
+			   double min_giant_fraction, int num_threads) {
+  PhenoNet pheno_net(std::move(time_series), min_giant_fraction);
+  return FindChunkPeaks(pheno_net, num_threads);
+}
+
+template<typename T>
+vector<int> FindChunkPeaks(vector<TimeSeries<T>> &&time_series,
+			   const BandQuantization &quantization,
+			   double min_giant_fraction, int num_threads) {
+  PhenoNet pheno_net(std::move(time_series), quantization, min_giant_fraction);
+  return FindChunkPeaks(pheno_net, num_threads);
+}
+
+template<typename T>
+bool FindPeaks(vector<TimeSeries<T>> &&time_series,
+	       const BandQuantization &quantization, int num_pixels_per_chunk,
+	       double min_giant_fraction, int num_threads, MPI_Comm communicator,
+	       vector<int> &peaks) {
+  WorkStealingScheduler<T> scheduler(std::move(time_series),
+				     num_pixels_per_chunk, communicator);
+  auto find_peaks = [&](vector<TimeSeries<T>> &&time_series) {
+    return FindChunkPeaks(std::move(time_series), quantization,
+			  min_giant_fraction, num_threads);
+  };
+  if (!scheduler.Run(find_peaks)) {
+    return false;
   }
+  peaks = scheduler.GetResults();
+  return true;
 }
@@ -0,0 +1,697 @@
+//============================================================================
+// Name        : PhenoCheck.cpp
+// Author      : RSSI (rssiuiuc@gmail.com)
+// Description : Checks that the optimized paths of the library match the
+//               reference ones on generated inputs
+//============================================================================
+
+#include "BitsetNetwork.h"
+#include "CompactNetwork.h"
+#include "IncrementalNetwork.h"
+#include "NetworkUtils.h"
+#include "PhenoNet.h"
+#include "PixelBlock.h"
+#include "SimilarityKernel.h"
+#include "TextLoader.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+using namespace simple_graph;
+
+typedef vector<pair<pair<int, int>, float>> EdgeList;
+
+namespace {
+
+// The number of failed checks.
+int num_failures = 0;
+
+void Report(const string &name, bool passed, const string &detail = "") {
+  cout << (passed ? "PASS " : "FAIL ") << name;
+  if (!passed && !detail.empty()) {
+    cout << ": " << detail;
+  }
+  cout << endl;
+  if (!passed) {
+    ++num_failures;
+  }
+}
+
+// Whether two values are equal up to float rounding (of sums of a few
+// thousand terms).
+bool IsClose(float value, float expected) {
+  return fabs(value - expected) <= 1e-4 * fabs(expected) + 1e-7;
+}
+
+// Returns a random graph of num_nodes nodes where each pair of nodes is
+// connected with the given probability.
+EdgeList RandomEdges(int num_nodes, double probability, mt19937 &random) {
+  uniform_real_distribution<double> uniform(0, 1);
+  EdgeList edges;
+  for (int i = 0; i < num_nodes; ++i) {
+    for (int j = i + 1; j < num_nodes; ++j) {
+      if (uniform(random) < probability) {
+	edges.push_back(make_pair(make_pair(i, j), 1.0f));
+      }
+    }
+  }
+  return edges;
+}
+
+// Returns the test graphs of num_nodes nodes: a path, a star, a clique, two
+// paths with an isolated node and a random graph.
+vector<EdgeList> TestGraphs(int num_nodes, mt19937 &random) {
+  vector<EdgeList> graphs(4);
+  for (int i = 1; i < num_nodes; ++i) {
+    graphs[0].push_back(make_pair(make_pair(i - 1, i), 1.0f));
+    graphs[1].push_back(make_pair(make_pair(0, i), 1.0f));
+    if (i != num_nodes / 2 && i < num_nodes - 1) {
+      graphs[3].push_back(make_pair(make_pair(i - 1, i), 1.0f));
+    }
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    for (int j = i + 1; j < num_nodes; ++j) {
+      graphs[2].push_back(make_pair(make_pair(i, j), 1.0f));
+    }
+  }
+  graphs.push_back(RandomEdges(num_nodes, 4.0 / num_nodes, random));
+  return graphs;
+}
+
+// Compares the bit-parallel betweenness centrality with the queue based one
+// on the test graphs, including ones larger than kMaxBitsetBetweennessSize
+// and ones where a search reaches all levels. The normalization size makes
+// the CompactNetwork overload use the queue based algorithm.
+void CheckBitsetBetweenness() {
+  const size_t normalization_size = 2 * utils::kMaxBitsetBetweennessSize;
+  mt19937 random(7);
+  bool passed = true;
+  string detail;
+  for (int num_nodes : { 2, 3, 63, 64, 65, 200, 600 }) {
+    const vector<EdgeList> graphs = TestGraphs(num_nodes, random);
+    for (size_t g = 0; g < graphs.size() && passed; ++g) {
+      const CompactNetwork network(num_nodes, graphs[g], graphs[g].size());
+      const vector<float> betweenness = utils::GetNodeBetweennessCentrality(
+	BitsetNetwork(network), normalization_size);
+      const vector<float> expected =
+	utils::GetNodeBetweennessCentrality(network, normalization_size);
+      for (int i = 0; i < num_nodes && passed; ++i) {
+	if (!IsClose(betweenness[i], expected[i])) {
+	  passed = false;
+	  detail = "graph " + to_string(g) + " of " + to_string(num_nodes)
+	    + " nodes, node " + to_string(i);
+	}
+      }
+    }
+  }
+  Report("bitset vs queue betweenness", passed, detail);
+}
+
+// Compares the parallel betweenness centrality of single networks with the
+// single-threaded one, bit for bit, for several numbers of threads and for
+// networks on both sides of kMaxBitsetBetweennessSize.
+void CheckParallelBetweenness() {
+  int max_threads = 1;
+#ifdef _OPENMP
+  max_threads = omp_get_max_threads();
+#endif
+  mt19937 random(25);
+  bool passed = true;
+  string detail;
+  for (int num_nodes : { 300, 700 }) {
+    vector<EdgeList> graphs = TestGraphs(num_nodes, random);
+    // The clique is the same for all threads and slow for 700 nodes.
+    graphs.erase(graphs.begin() + 2);
+    for (size_t g = 0; g < graphs.size() && passed; ++g) {
+      const CompactNetwork network(num_nodes, graphs[g], graphs[g].size());
+      const vector<float> expected = utils::GetNodeBetweennessCentrality(
+	network);
+      for (int num_threads : { 1, 2, 5, max_threads }) {
+	const vector<float> betweenness =
+	  utils::GetNodeBetweennessCentrality(network, 0, num_threads);
+	if (memcmp(betweenness.data(), expected.data(),
+		   sizeof(float) * num_nodes)) {
+	  passed = false;
+	  detail = "graph " + to_string(g) + " of " + to_string(num_nodes)
+	    + " nodes, " + to_string(num_threads) + " threads";
+	}
+      }
+    }
+  }
+  Report("parallel vs single-threaded betweenness", passed, detail);
+}
+
+// Adds nodes to an IncrementalNetwork and compares its measures with the
+// ones of the grown network computed from scratch. The betweenness
+// centrality is normalized by the size of the base network, like
+// PhenoNet::AddRealTimeNode() does.
+void CheckIncrementalNetwork() {
+  const int num_base_nodes = 120;
+  const int num_added_nodes = 20;
+  mt19937 random(9);
+  EdgeList edges = RandomEdges(num_base_nodes, 0.04, random);
+  IncrementalNetwork network(
+	CompactNetwork(num_base_nodes, edges, edges.size()));
+  uniform_int_distribution<int> num_neighbors(0, 4);
+  bool passed = true;
+  string detail;
+  for (int k = 0; k < num_added_nodes && passed; ++k) {
+    const int node = num_base_nodes + k;
+    vector<size_t> neighbors;
+    for (int n = num_neighbors(random); n > 0; --n) {
+      neighbors.push_back(uniform_int_distribution<int>(0, node - 1)(random));
+    }
+    network.AddNode(neighbors);
+    for (size_t neighbor : neighbors) {
+      edges.push_back(make_pair(make_pair(static_cast<int>(neighbor), node),
+				1.0f));
+    }
+
+    const CompactNetwork full(node + 1, edges, edges.size());
+    const vector<float> betweenness =
+      network.GetNodeBetweennessCentrality(num_base_nodes);
+    const vector<float> expected_betweenness =
+      utils::GetNodeBetweennessCentrality(full, num_base_nodes);
+    const vector<float> clustering = network.GetAllClusteringCoefficients();
+    const vector<float> expected_clustering =
+      utils::GetAllClusteringCoefficients(full);
+    for (int i = 0; i <= node && passed; ++i) {
+      if (!IsClose(betweenness[i], expected_betweenness[i])
+	  || clustering[i] != expected_clustering[i]) {
+	passed = false;
+	detail = "node " + to_string(i) + " after " + to_string(k + 1)
+	  + " added nodes";
+      }
+    }
+    vector<size_t> giant_component = network.ExtractGiantComponent();
+    vector<size_t> expected_giant_component =
+      utils::ExtractGiantComponent(full);
+    sort(expected_giant_component.begin(), expected_giant_component.end());
+    if (passed && giant_component != expected_giant_component) {
+      passed = false;
+      detail = "giant component after " + to_string(k + 1) + " added nodes";
+    }
+  }
+  Report("incremental network vs full recompute", passed, detail);
+}
+
+// Returns num_pixels random time series of num_time_slices time slices of
+// num_bands bands, where some time slices are 0 (invalid).
+vector<remote_sensing::TimeSeries<float>> RandomTimeSeries(
+    int num_pixels, int num_time_slices, int num_bands, mt19937 &random) {
+  uniform_real_distribution<float> uniform(-0.2, 1);
+  vector<remote_sensing::TimeSeries<float>> time_series;
+  for (int p = 0; p < num_pixels; ++p) {
+    vector<float> values(num_time_slices * num_bands);
+    for (float &value : values) {
+      value = uniform(random);
+    }
+    for (int t = p % 5; t < num_time_slices; t += 17) {
+      fill(values.begin() + t * num_bands,
+	   values.begin() + (t + 1) * num_bands, 0.0f);
+    }
+    time_series.emplace_back(std::move(values), num_bands);
+  }
+  return time_series;
+}
+
+// Returns the edges of the time slices [start_time, end_time) of a time
+// series computed with SimilarityCosine() in a nested loop.
+vector<remote_sensing::utils::WeightedEdge> ReferenceEdges(
+    const remote_sensing::TimeSeries<float> &time_series, int start_time,
+    int end_time, float min_weight) {
+  vector<remote_sensing::utils::WeightedEdge> edges;
+  for (int i = start_time; i < end_time; ++i) {
+    for (int j = i + 1; j < end_time; ++j) {
+      const float weight = remote_sensing::utils::SimilarityCosine(
+	time_series.GetTimeSlice(i), time_series.GetTimeSlice(j));
+      if (weight >= min_weight) {
+	edges.push_back(make_pair(make_pair(i, j), weight));
+      }
+    }
+  }
+  return edges;
+}
+
+// Whether two edge lists have the same edges in the same order, with the
+// same weights (bit for bit).
+bool IsSameEdges(const vector<remote_sensing::utils::WeightedEdge> &edges,
+		 const vector<remote_sensing::utils::WeightedEdge> &expected) {
+  if (edges.size() != expected.size()) {
+    return false;
+  }
+  for (size_t k = 0; k < edges.size(); ++k) {
+    if (edges[k].first != expected[k].first
+	|| memcmp(&edges[k].second, &expected[k].second, sizeof(float))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Compares the edges of the blocked band major similarity kernel and of the
+// interleaved kernel with the ones of SimilarityCosine(), for the
+// specialized band counts and a generic one, on windows that are not a
+// multiple of the row block or of the SIMD width and a number of pixels that
+// is not a multiple of InterleavedPixelBlock::kLanes. Build with
+// ARCH=-march=native to check the vectorized kernels.
+void CheckSimilarityKernels() {
+  const int num_pixels = 21;
+  const int num_time_slices = 103;
+  const float min_weight = 0.6;
+  mt19937 random(2);
+  bool passed = true;
+  string detail;
+  for (int num_bands : { 5, 7, 10, 13 }) {
+    const vector<remote_sensing::TimeSeries<float>> time_series =
+      RandomTimeSeries(num_pixels, num_time_slices, num_bands, random);
+    remote_sensing::utils::SimilarityWorkspace workspace;
+    for (int p = 0; p < num_pixels && passed; ++p) {
+      const int start_time = p % 3 ? 0 : 5;
+      const int end_time = num_time_slices - p % 4;
+      vector<remote_sensing::utils::WeightedEdge> edges;
+      remote_sensing::utils::AppendCosineSimilarityEdges(
+	time_series[p], start_time, end_time, min_weight, workspace, edges);
+      if (!IsSameEdges(edges, ReferenceEdges(time_series[p], start_time,
+					     end_time, min_weight))) {
+	passed = false;
+	detail = to_string(num_bands) + " bands, pixel " + to_string(p);
+      }
+    }
+
+    vector<remote_sensing::PixelView<float>> pixels;
+    for (const auto &pixel : time_series) {
+      pixels.emplace_back(pixel);
+    }
+    remote_sensing::InterleavedPixelBlock block;
+    remote_sensing::utils::BlockSimilarityWorkspace block_workspace;
+    vector<vector<remote_sensing::utils::WeightedEdge>> block_edges;
+    for (int first_pixel = 0; first_pixel < num_pixels && passed;
+	 first_pixel += remote_sensing::InterleavedPixelBlock::kLanes) {
+      for (auto &edges : block_edges) {
+	edges.clear();
+      }
+      passed = block.Load(pixels, first_pixel);
+      remote_sensing::utils::AppendBlockCosineSimilarityEdges(
+	block, 3, num_time_slices, min_weight, block_workspace, block_edges);
+      for (size_t lane = 0; lane < block.GetNumPixels() && passed; ++lane) {
+	if (!IsSameEdges(block_edges[lane],
+			 ReferenceEdges(time_series[first_pixel + lane], 3,
+					num_time_slices, min_weight))) {
+	  passed = false;
+	  detail = to_string(num_bands) + " bands, pixel "
+	    + to_string(first_pixel + lane) + " of a block";
+	}
+      }
+    }
+  }
+  Report("similarity kernels vs SimilarityCosine", passed, detail);
+}
+
+// Compares TextLoader::ParseFloat() with strtof on random numbers printed
+// in various formats, including long mantissas, subnormal and overflowing
+// exponents. The values must have the same bits and end at the same place.
+void CheckParseFloat() {
+  const char *formats[] = { "%g", "%.9g", "%.3f", "%.7e", "%.17g", "%.25f",
+			    "%.40g" };
+  mt19937 random(19);
+  uniform_real_distribution<double> mantissa(-10, 10);
+  uniform_int_distribution<int> exponent(-50, 42);
+  bool passed = true;
+  string detail;
+  for (int i = 0; i < 200000 && passed; ++i) {
+    const double number = mantissa(random) * pow(10.0, exponent(random));
+    char text[128];
+    snprintf(text, sizeof(text), formats[i % (sizeof(formats)
+					      / sizeof(formats[0]))], number);
+    const char *end = text + strlen(text);
+    float value = 0;
+    const char *value_end = remote_sensing::TextLoader::ParseFloat(text, end,
+								   value);
+    char *expected_end;
+    const float expected = strtof(text, &expected_end);
+    if (value_end != expected_end
+	|| memcmp(&value, &expected, sizeof(value)) != 0) {
+      passed = false;
+      detail = text;
+    }
+  }
+  Report("ParseFloat vs strtof", passed, detail);
+}
+
+// Returns num_pixels time series of num_years years of daily time slices of
+// num_bands bands with a seasonal peak that differs from pixel to pixel,
+// and noise.
+vector<remote_sensing::TimeSeries<float>> SeasonalTimeSeries(
+    int num_pixels, int num_years, int num_bands, mt19937 &random) {
+  const int num_days = 365;
+  normal_distribution<float> noise(0, 0.02);
+  uniform_real_distribution<float> peak_day(120, 240);
+  vector<remote_sensing::TimeSeries<float>> time_series;
+  for (int p = 0; p < num_pixels; ++p) {
+    const float peak = peak_day(random);
+    vector<float> values;
+    for (int t = 0; t < num_years * num_days; ++t) {
+      const float season = (t % num_days - peak) / 40;
+      for (int b = 0; b < num_bands; ++b) {
+	const float amplitude = b % 2 ? 0.4 : -0.1;
+	values.push_back(0.3 + 0.05 * b + amplitude * exp(-season * season)
+			 + noise(random));
+      }
+    }
+    time_series.emplace_back(std::move(values), num_bands);
+  }
+  return time_series;
+}
+
+// Whether two sweeps found the same peaks with the same bridging
+// coefficients (bit for bit).
+bool IsSameSweep(const vector<vector<remote_sensing::PhenoNet::Peak>> &sweep,
+		 const vector<vector<remote_sensing::PhenoNet::Peak>> &expected,
+		 string &detail) {
+  for (size_t p = 0; p < expected.size(); ++p) {
+    for (size_t k = 0; k < expected[p].size(); ++k) {
+      if (sweep[p][k].time_slice_index != expected[p][k].time_slice_index
+	  || memcmp(&sweep[p][k].bridging_coefficient,
+		    &expected[p][k].bridging_coefficient, sizeof(float))) {
+	detail = "pixel " + to_string(p) + " sweep " + to_string(k);
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Whether a sweep found at least one peak, so that comparing it is
+// meaningful.
+bool HasPeaks(const vector<vector<remote_sensing::PhenoNet::Peak>> &sweep) {
+  for (const auto &peaks : sweep) {
+    for (const auto &peak : peaks) {
+      if (peak.time_slice_index != INT_MAX) {
+	return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Whether the base peaks of the pixels [first_pixel, first_pixel +
+// num_pixels) of expected match the ones of pheno_net.
+bool IsSameBasePeaks(const remote_sensing::PhenoNet &pheno_net,
+		     const remote_sensing::PhenoNet &expected, size_t first_pixel,
+		     size_t num_pixels, string &detail) {
+  for (size_t p = 0; p < num_pixels; ++p) {
+    remote_sensing::PhenoNet::Peak peak, expected_peak;
+    const bool found = pheno_net.GetBasePeak(p, peak);
+    if (found != expected.GetBasePeak(first_pixel + p, expected_peak)
+	|| (found && (peak.time_slice_index != expected_peak.time_slice_index
+		      || memcmp(&peak.bridging_coefficient,
+				&expected_peak.bridging_coefficient,
+				sizeof(float))))) {
+      detail = "base peak of pixel " + to_string(first_pixel + p);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Saves base networks to a cache file and loads them back, whole and from
+// the middle of the tile, then compares the base peaks and the bridging
+// coefficients of real-time nodes added to the built and to the loaded
+// networks. A truncated file must be rejected, and so must a record with an
+// invalid neighbor, without affecting the other records.
+void CheckBaseNetworkCache() {
+  const int num_pixels = 8;
+  const int first_pixel = 3;
+  const string path = "pheno_check_base_networks.bin";
+  mt19937 random(10);
+  const vector<remote_sensing::TimeSeries<float>> time_series =
+    SeasonalTimeSeries(num_pixels, 1, 7, random);
+  const vector<remote_sensing::TimeSeries<float>> observations =
+    SeasonalTimeSeries(num_pixels, 1, 7, random);
+  vector<remote_sensing::TimeSeries<float>> pixels = time_series;
+  remote_sensing::PhenoNet built(std::move(pixels), 0.3);
+  built.BuildBaseNetworks();
+  remote_sensing::PhenoNet::Peak peak;
+  string detail = "no base networks";
+  bool passed = built.GetBasePeak(0, peak) && built.SaveBaseNetworks(path);
+
+  pixels = time_series;
+  remote_sensing::PhenoNet loaded(std::move(pixels), 0.3);
+  passed = passed && loaded.LoadBaseNetworks(path, 0)
+    && IsSameBasePeaks(loaded, built, 0, num_pixels, detail);
+  for (int p = 0; p < num_pixels && passed; ++p) {
+    for (int t : { 150, 200 }) {
+      const float *values = observations[p].GetData() + 7 * t;
+      const vector<float> time_slice(values, values + 7);
+      float bridging_coefficient, expected;
+      if (built.GetBasePeak(p, peak)
+	  && (!loaded.AddRealTimeNode(p, time_slice, bridging_coefficient)
+	      || !built.AddRealTimeNode(p, time_slice, expected)
+	      || memcmp(&bridging_coefficient, &expected, sizeof(float)))) {
+	passed = false;
+	detail = "real-time node of pixel " + to_string(p);
+      }
+    }
+  }
+
+  pixels.assign(time_series.begin() + first_pixel, time_series.end());
+  remote_sensing::PhenoNet range(std::move(pixels), 0.3);
+  passed = passed && range.LoadBaseNetworks(path, first_pixel)
+    && IsSameBasePeaks(range, built, first_pixel, num_pixels - first_pixel,
+		       detail);
+
+  // Replaces the first neighbor of pixel 0 with an invalid node id: the
+  // offset of its record follows the 16 byte file header, and its neighbors
+  // follow the 16 byte record header and the 366 offsets of the network.
+  ifstream in(path, ios::binary);
+  string contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  in.close();
+  uint64_t record;
+  memcpy(&record, &contents[16], sizeof(record));
+  const uint32_t invalid_node = 100000;
+  memcpy(&contents[record + 16 + 4 * 366], &invalid_node, sizeof(invalid_node));
+  ofstream(path, ios::binary) << contents;
+  pixels = time_series;
+  remote_sensing::PhenoNet corrupted(std::move(pixels), 0.3);
+  if (passed && (!corrupted.LoadBaseNetworks(path, 0)
+		 || corrupted.GetBasePeak(0, peak)
+		 || corrupted.GetBasePeak(1, peak) != built.GetBasePeak(1, peak))) {
+    passed = false;
+    detail = "invalid neighbor";
+  }
+  ofstream(path, ios::binary) << contents.substr(0, contents.size() / 2);
+  pixels = time_series;
+  remote_sensing::PhenoNet truncated(std::move(pixels), 0.3);
+  if (passed && truncated.LoadBaseNetworks(path, 0)) {
+    passed = false;
+    detail = "truncated file";
+  }
+  remove(path.c_str());
+  Report("base network cache round trip", passed, detail);
+}
+
+// Compares the peaks and bridging coefficients of pheno networks whose edges
+// are selected in growing batches with the ones of a full sort, on time
+// series rounded to a few levels, so that many similarities are tied.
+void CheckEdgeOrdering() {
+  const int num_pixels = 16;
+  mt19937 random(4);
+  vector<remote_sensing::TimeSeries<float>> time_series =
+    SeasonalTimeSeries(num_pixels, 1, 7, random);
+  for (auto &pixel : time_series) {
+    for (size_t t = 0; t < pixel.GetNumTimeSlices(); ++t) {
+      float *values = pixel.GetMutableTimeSlice(t);
+      for (int b = 0; b < 7; ++b) {
+	values[b] = round(values[b] * 8) / 8;
+      }
+    }
+  }
+  vector<vector<remote_sensing::PhenoNet::Peak>> sweeps[2];
+  for (int incremental = 0; incremental < 2; ++incremental) {
+    vector<remote_sensing::TimeSeries<float>> pixels = time_series;
+    remote_sensing::PhenoNet pheno_net(std::move(pixels), 0.3);
+    pheno_net.SetEdgeOrdering(
+      incremental ? remote_sensing::PhenoNet::EdgeOrdering::kIncremental
+      : remote_sensing::PhenoNet::EdgeOrdering::kFullSort);
+    pheno_net.ProcessSweep({ 0.1, 0.3, 0.6, 0.9 }, { 3, 5 });
+    sweeps[incremental] = pheno_net.GetSweepPeaks();
+  }
+  string detail = "no peaks found";
+  const bool passed = HasPeaks(sweeps[0])
+    && IsSameSweep(sweeps[1], sweeps[0], detail);
+  Report("incremental vs full edge sort", passed, detail);
+}
+
+// Quantizes the time series with the given quantization, and replaces their
+// values with the decoded ones, so that both have the same similarities up
+// to rounding.
+template<typename T>
+vector<remote_sensing::TimeSeries<T>> Quantize(
+    vector<remote_sensing::TimeSeries<float>> &time_series,
+    const remote_sensing::BandQuantization &quantization) {
+  const size_t num_bands = quantization.scales.size();
+  vector<remote_sensing::TimeSeries<T>> quantized;
+  for (auto &pixel : time_series) {
+    vector<T> values;
+    for (size_t t = 0; t < pixel.GetNumTimeSlices(); ++t) {
+      float *slice = pixel.GetMutableTimeSlice(t);
+      for (size_t b = 0; b < num_bands; ++b) {
+	const T value = static_cast<T>(lround(
+	  (slice[b] - quantization.offsets[b]) / quantization.scales[b]));
+	slice[b] = value * quantization.scales[b] + quantization.offsets[b];
+	values.push_back(value);
+      }
+    }
+    quantized.emplace_back(std::move(values), num_bands);
+  }
+  return quantized;
+}
+
+// Compares the peaks of quantized pixels with the ones of their decoded
+// values, for a proportional quantization (exact integer similarities) and
+// one with offsets and a scale per band (double precision similarities).
+// Only the peaks are compared: the similarities of the quantized kernels
+// are more accurate, so an edge may be selected before another one whose
+// weight only differs in the last bit, which slightly changes the bridging
+// coefficients.
+template<typename T>
+void CheckQuantizedPixels(const string &name) {
+  const int num_pixels = 8;
+  const size_t num_bands = 7;
+  mt19937 random(20);
+  const vector<remote_sensing::TimeSeries<float>> time_series =
+    SeasonalTimeSeries(num_pixels, 1, num_bands, random);
+  remote_sensing::BandQuantization quantizations[2];
+  quantizations[0].scales.assign(num_bands, 1e-4);
+  quantizations[0].offsets.assign(num_bands, 0);
+  for (size_t b = 0; b < num_bands; ++b) {
+    // Up to 1.3 / 4e-5 = 32500, which fits in an int16.
+    quantizations[1].scales.push_back(4e-5 + 1e-5 * b);
+    quantizations[1].offsets.push_back(-0.2);
+  }
+  bool passed = true;
+  string detail;
+  for (int q = 0; q < 2 && passed; ++q) {
+    vector<remote_sensing::TimeSeries<float>> pixels = time_series;
+    remote_sensing::PhenoNet quantized(Quantize<T>(pixels, quantizations[q]),
+				       quantizations[q], 0.3);
+    remote_sensing::PhenoNet decoded(std::move(pixels), 0.3);
+    quantized.ProcessSweep({ 0.3, 0.6 }, { 3, 5 });
+    decoded.ProcessSweep({ 0.3, 0.6 }, { 3, 5 });
+    const auto &sweep = quantized.GetSweepPeaks();
+    const auto &expected = decoded.GetSweepPeaks();
+    passed = HasPeaks(expected);
+    detail = "no peaks found";
+    for (int p = 0; p < num_pixels && passed; ++p) {
+      for (size_t k = 0; k < expected[p].size() && passed; ++k) {
+	if (sweep[p][k].time_slice_index != expected[p][k].time_slice_index) {
+	  passed = false;
+	  detail = string(q ? "scales and offsets" : "proportional")
+	    + ", pixel " + to_string(p) + " sweep " + to_string(k);
+	}
+      }
+    }
+  }
+  Report(name + " vs decoded pixels", passed, detail);
+}
+
+// Compares the peaks and bridging coefficients of windowed pheno networks
+// with the ones of full networks, for time ranges shorter and longer than
+// kMaxBitsetBetweennessSize of a two year time series.
+void CheckWindowedNetworks() {
+  const int num_pixels = 16;
+  mt19937 random(22);
+  const vector<remote_sensing::TimeSeries<float>> time_series =
+    SeasonalTimeSeries(num_pixels, 2, 7, random);
+  vector<pair<int, int>> time_ranges;
+  for (int p = 0; p < num_pixels; ++p) {
+    const int length = p % 2 ? 300 : 600;
+    const int start_time = uniform_int_distribution<int>(
+      0, 730 - length)(random);
+    time_ranges.push_back(make_pair(start_time, start_time + length));
+  }
+  vector<vector<remote_sensing::PhenoNet::Peak>> sweeps[2];
+  for (int windowed = 0; windowed < 2; ++windowed) {
+    vector<remote_sensing::TimeSeries<float>> pixels = time_series;
+    remote_sensing::PhenoNet pheno_net(std::move(pixels), 0.3);
+    pheno_net.SetWindowedNetworks(windowed);
+    for (int p = 0; p < num_pixels; ++p) {
+      pheno_net.SetTimeRange(p, time_ranges[p].first, time_ranges[p].second);
+    }
+    pheno_net.ProcessSweep({ 0.2, 0.3 }, { 3, 5 });
+    sweeps[windowed] = pheno_net.GetSweepPeaks();
+  }
+  string detail = "no peaks found";
+  const bool passed = HasPeaks(sweeps[0])
+    && IsSameSweep(sweeps[1], sweeps[0], detail);
+  Report("windowed vs full pheno networks", passed, detail);
+}
+
+// Compares the peaks and bridging coefficients of pheno networks built from
+// the nearest neighbor candidate edges with the ones built from all pairs
+// of time slices, on two year time series and some shorter time ranges.
+void CheckNearestNeighbors() {
+  const int num_pixels = 16;
+  mt19937 random(23);
+  const vector<remote_sensing::TimeSeries<float>> time_series =
+    SeasonalTimeSeries(num_pixels, 2, 7, random);
+  vector<vector<remote_sensing::PhenoNet::Peak>> sweeps[2];
+  vector<int> peaks[2];
+  for (int nearest = 0; nearest < 2; ++nearest) {
+    vector<remote_sensing::TimeSeries<float>> pixels = time_series;
+    remote_sensing::PhenoNet pheno_net(std::move(pixels), 0.3);
+    pheno_net.SetNearestNeighbors(nearest ? 8 : 0);
+    for (int p = 0; p < num_pixels; p += 4) {
+      pheno_net.SetTimeRange(p, 100, 500);
+    }
+    pheno_net.Process();
+    peaks[nearest] = pheno_net.GetPeakTimeSliceIndex();
+    pheno_net.ProcessSweep({ 0.2, 0.3 }, { 3, 5 });
+    sweeps[nearest] = pheno_net.GetSweepPeaks();
+  }
+  string detail = "no peaks found";
+  bool passed = HasPeaks(sweeps[0]);
+  for (int p = 0; p < num_pixels && passed; ++p) {
+    if (peaks[1][p] != peaks[0][p]) {
+      passed = false;
+      detail = "pixel " + to_string(p);
+    }
+  }
+  passed = passed && IsSameSweep(sweeps[1], sweeps[0], detail);
+  Report("nearest neighbors vs all pairs", passed, detail);
+}
+
+} /* namespace */
+
+// Usage: pheno_check. Returns EXIT_FAILURE if any check fails.
+int main() {
+  CheckBitsetBetweenness();
+  CheckParallelBetweenness();
+  CheckIncrementalNetwork();
+  CheckBaseNetworkCache();
+  CheckSimilarityKernels();
+  CheckParseFloat();
+  CheckEdgeOrdering();
+  CheckQuantizedPixels<int16_t>("int16 pixels");
+  CheckQuantizedPixels<uint16_t>("uint16 pixels");
+  CheckWindowedNetworks();
+  CheckNearestNeighbors();
+  return num_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,50 @@
+//============================================================================
+// Name        : PhenoMapped.cpp
+// Author      : RSSI (rssiuiuc@gmail.com)
+// Description : Finds the peaks of a tile cube in place on a single node
+//============================================================================
+
+#include "MappedCube.h"
+#include "PhenoNet.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace remote_sensing;
+
+// Usage: pheno_mapped <cube> [first pixel] [number of pixels]. Maps a
+// float32 cube made by convert_cube and processes its pixels without reading
+// or copying them, using the threads of this node.
+int main(int argc, char* argv[]) {
+  const double min_giant_fraction = 0.8;
+  // 0 uses the OpenMP default (OMP_NUM_THREADS or all cores).
+  const int num_threads = 0;
+
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <cube> [first pixel] "
+	 << "[number of pixels]" << endl;
+    return EXIT_FAILURE;
+  }
+  MappedCube cube;
+  if (!cube.Open(argv[1])) {
+    return EXIT_FAILURE;
+  }
+  const uint64_t first_pixel = argc > 2 ? atoll(argv[2]) : 0;
+  const uint64_t num_pixels = argc > 3 ? atoll(argv[3])
+    : cube.GetNumPixels();
+  vector<PixelView<float>> pixels = cube.GetPixels(first_pixel, num_pixels);
+  const size_t num_cube_pixels = pixels.size();
+
+  PhenoNet pheno_net(std::move(pixels), min_giant_fraction);
+  pheno_net.SetNumThreads(num_threads);
+  pheno_net.Process();
+  const auto &peak_index = pheno_net.GetPeakTimeSliceIndex();
+  for (size_t i = 0; i < num_cube_pixels; ++i) {
+    cout << "pixel #" << (first_pixel + i) << " peak: " << peak_index[i]
+	 << endl;
+  }
+  return 0;
+}
@@ -13,27 +13,150 @@
 #include <climits>
 #include <iostream>
 #include <vector>
-#include <unordered_set>
 #include <algorithm>
 
-using simple_graph::Network;
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using simple_graph::CompactNetwork;
 
 namespace remote_sensing {
 
+namespace {
+
+// The number of edges selected by the first batch of the incremental
+// ordering, per time slice. The batch size doubles afterwards. It is
+// relative to all time slices of a pixel even for windowed networks, like
+// the giant component size.
+constexpr std::size_t kInitialEdgeBatchPerTimeSlice = 4;
+
+// Networks of at least this size are worth splitting the betweenness
+// centrality among threads, when there are too few of them to keep the
+// threads busy one pixel per thread.
+constexpr std::size_t kMinIntraNetworkParallelSize = 1024;
+
+// Hands out the candidate edges of a pheno network in descending weight order
+// (see utils::IsHeavierEdge()). With the incremental ordering, the heaviest remaining
+// edges are selected and sorted in growing batches, so that only the prefix
+// that is actually consumed gets sorted. The order is the same either way.
+class EdgeOrder {
+public:
+	EdgeOrder(std::vector<utils::WeightedEdge> &edges, bool incremental,
+			std::size_t initial_batch_size) :
+			begin_(edges.begin()), next_(edges.begin()), batch_end_(
+					edges.begin()), end_(edges.end()), batch_size_(
+					incremental ?
+							std::max<std::size_t>(initial_batch_size, 1) :
+							edges.size()) {
+	}
+
+	// Returns the next edge, or nullptr if all edges have been handed out.
+	const utils::WeightedEdge* Next() {
+		if (next_ == batch_end_) {
+			if (next_ == end_) {
+				return nullptr;
+			}
+			if (batch_size_ < static_cast<std::size_t>(end_ - next_)) {
+				batch_end_ = next_ + batch_size_;
+				std::nth_element(next_, batch_end_, end_,
+						utils::IsHeavierEdge);
+			} else {
+				batch_end_ = end_;
+			}
+			std::sort(next_, batch_end_, utils::IsHeavierEdge);
+			batch_size_ *= 2;
+		}
+		return &*next_++;
+	}
+
+	// Returns the number of edges handed out so far. Those are the first
+	// edges of the vector.
+	std::size_t GetNumHandedOut() const {
+		return next_ - begin_;
+	}
+
+private:
+	std::vector<utils::WeightedEdge>::iterator begin_, next_, batch_end_, end_;
+	std::size_t batch_size_;
+};
+
+// Reports a pheno network that is too fragmented. The pixels are analyzed by
+// several threads, so the messages are written one at a time.
+void ReportFragmentedNetwork() {
+#ifdef _OPENMP
+#pragma omp critical(pheno_net_log)
+#endif
+	std::clog << "The pheno network is too fragmented to meet the given "
+			<< "requirement\n";
+}
+
+// Connects the edges handed out by edge_order until the giant component
+// reaches min_giant_component_size or all edges have been connected. The
+// connected edges are the first edge_order.GetNumHandedOut() edges.
+void ConnectEdgesUntil(EdgeOrder &edge_order,
+		std::size_t min_giant_component_size,
+		simple_graph::utils::UnionFind &uf) {
+	while (uf.GiantComponentSize() < min_giant_component_size) {
+		const utils::WeightedEdge *edge = edge_order.Next();
+		if (edge == nullptr) {
+			break;
+		}
+		uf.Union(edge->first.first, edge->first.second);
+	}
+}
+
+} /* namespace */
+
 PhenoNet::PhenoNet(std::vector<TimeSeries<float>> &&pixel_time_series,
 		float min_giant_component_fraction) :
-		time_series_data_(std::move(pixel_time_series)), moving_window_size_(5) {
+		time_series_data_(std::move(pixel_time_series)), moving_window_size_(5), num_threads_(
+				0), pixel_batching_(true), edge_ordering_(
+				EdgeOrdering::kIncremental), windowed_networks_(false), nearest_neighbors_(0) {
+	pixels_.reserve(time_series_data_.size());
+	for (const auto &time_series : time_series_data_) {
+		pixels_.push_back(PixelView<float>(time_series));
+	}
+	Initialize(min_giant_component_fraction);
+}
+
+PhenoNet::PhenoNet(std::vector<PixelView<float>> &&pixels,
+		float min_giant_component_fraction) :
+		pixels_(std::move(pixels)), moving_window_size_(5), num_threads_(0), pixel_batching_(
+				true), edge_ordering_(EdgeOrdering::kIncremental), windowed_networks_(
+				false), nearest_neighbors_(0) {
+	Initialize(min_giant_component_fraction);
+}
+
+PhenoNet::PhenoNet(std::vector<TimeSeries<std::int16_t>> &&pixel_time_series,
+		const BandQuantization &quantization,
+		float min_giant_component_fraction) :
+		int16_data_(std::move(pixel_time_series)), quantization_(quantization), moving_window_size_(
+				5), num_threads_(0), pixel_batching_(true), edge_ordering_(
+				EdgeOrdering::kIncremental), windowed_networks_(false), nearest_neighbors_(0) {
+	Initialize(min_giant_component_fraction);
+}
+
+PhenoNet::PhenoNet(std::vector<TimeSeries<std::uint16_t>> &&pixel_time_series,
+		const BandQuantization &quantization,
+		float min_giant_component_fraction) :
+		uint16_data_(std::move(pixel_time_series)), quantization_(quantization), moving_window_size_(
+				5), num_threads_(0), pixel_batching_(true), edge_ordering_(
+				EdgeOrdering::kIncremental), windowed_networks_(false), nearest_neighbors_(0) {
+	Initialize(min_giant_component_fraction);
+}
 
-	start_time_.resize(time_series_data_.size(), 0);
-	end_time_.resize(time_series_data_.size(), 0);
-	for (std::size_t i = 0; i < time_series_data_.size(); ++i) {
-		end_time_[i] = time_series_data_[i].GetNumTimeSlices();
+void PhenoNet::Initialize(float min_giant_component_fraction) {
+	const std::size_t num_pixels = GetNumPixels();
+	start_time_.resize(num_pixels, 0);
+	end_time_.resize(num_pixels, 0);
+	for (std::size_t i = 0; i < num_pixels; ++i) {
+		end_time_[i] = GetNumTimeSlices(i);
 	}
-	if (!time_series_data_.empty()) {
+	if (num_pixels > 0) {
 		min_valid_time_range_ = 0;
-		min_giant_component_size_ =
-				static_cast<std::size_t>(time_series_data_[0].GetNumTimeSlices()
-						* min_giant_component_fraction);
+		min_giant_component_size_ = GetMinGiantComponentSize(
+				min_giant_component_fraction);
 	} else {
 		min_valid_time_range_ = INT_MAX;
 		min_giant_component_size_ = INT_MAX;
@@ -43,110 +166,721 @@ PhenoNet::PhenoNet(std::vector<TimeSeries<float>> &&pixel_time_series,
 PhenoNet::~PhenoNet() {
 }
 
-Network PhenoNet::BuildPhenoNetworkByGiantComponentSize(
-		const TimeSeries<float> &time_series, int start_time, int end_time,
-		std::size_t min_giant_component_size) {
-	std::size_t num_time_slices = time_series.GetNumTimeSlices();
-	// Collects and sorts edges based on their weights.
-	std::vector<std::pair<std::pair<int, int>, float>> edges;
-	std::unordered_set<int> connected_nodes;
-	for (int i = start_time; i < end_time; ++i) {
-		for (int j = i + 1; j < end_time; ++j) {
-			const auto* slice1 = time_series.GetTimeSlice(i);
-			const auto* slice2 = time_series.GetTimeSlice(j);
-			if (slice1 == nullptr || slice2 == nullptr) {
-				continue;
+bool PhenoNet::SetTimeRange(std::size_t pixel, int start_time, int end_time) {
+	if (pixel >= GetNumPixels() || start_time < 0 || start_time >= end_time
+			|| end_time > static_cast<int>(GetNumTimeSlices(pixel))) {
+		std::cerr << "Invalid time range [" << start_time << ", " << end_time
+				<< ") of pixel " << pixel << std::endl;
+		return false;
+	}
+	start_time_[pixel] = start_time;
+	end_time_[pixel] = end_time;
+	return true;
+}
+
+std::size_t PhenoNet::GetNumPixels() const {
+	return pixels_.size() + int16_data_.size() + uint16_data_.size();
+}
+
+std::size_t PhenoNet::GetNumTimeSlices(std::size_t pixel) const {
+	if (!int16_data_.empty()) {
+		return int16_data_[pixel].GetNumTimeSlices();
+	} else if (!uint16_data_.empty()) {
+		return uint16_data_[pixel].GetNumTimeSlices();
+	}
+	return pixels_[pixel].GetNumTimeSlices();
+}
+
+TimeSlice<float> PhenoNet::GetTimeSlice(std::size_t pixel,
+		std::size_t time_slice_index, float *buffer) const {
+	if (!pixels_.empty()) {
+		return pixels_[pixel].GetTimeSlice(time_slice_index, buffer);
+	}
+	const std::size_t num_bands = quantization_.scales.size();
+	for (std::size_t b = 0; b < num_bands; ++b) {
+		const float stored =
+				!int16_data_.empty() ?
+						int16_data_[pixel].GetTimeSlice(time_slice_index)[b] :
+						uint16_data_[pixel].GetTimeSlice(time_slice_index)[b];
+		buffer[b] = stored * quantization_.scales[b] + quantization_.offsets[b];
+	}
+	return TimeSlice<float>(buffer, num_bands);
+}
+
+std::size_t PhenoNet::GetMinGiantComponentSize(
+		float min_giant_component_fraction) const {
+	if (GetNumPixels() == 0) {
+		return INT_MAX;
+	}
+	return static_cast<std::size_t>(GetNumTimeSlices(0)
+			* min_giant_component_fraction);
+}
+
+TimeSeries<float> PhenoNet::GetContiguousTimeSeries(std::size_t pixel_index,
+		PhenoWorkspace &workspace) const {
+	const PixelView<float> &pixel = pixels_[pixel_index];
+	const float *values = pixel.GetData();
+	if (!pixel.IsContiguous()) {
+		workspace.pixel_values.resize(
+				pixel.GetNumTimeSlices() * pixel.GetTimeSliceDimension());
+		pixel.CopyTo(workspace.pixel_values.data());
+		values = workspace.pixel_values.data();
+	}
+	return TimeSeries<float>(values, pixel.GetNumTimeSlices(),
+			pixel.GetTimeSliceDimension());
+}
+
+void PhenoNet::CollectCandidateEdges(std::size_t pixel_index,
+		int start_time, int end_time, PhenoWorkspace &workspace) const {
+	workspace.edges.clear();
+	// Skips small values for performance optimization
+	if (!int16_data_.empty()) {
+		utils::AppendCosineSimilarityEdges(int16_data_[pixel_index],
+				quantization_, start_time, end_time, utils::EPSILON,
+				workspace.similarity, workspace.edges);
+		return;
+	} else if (!uint16_data_.empty()) {
+		utils::AppendCosineSimilarityEdges(uint16_data_[pixel_index],
+				quantization_, start_time, end_time, utils::EPSILON,
+				workspace.similarity, workspace.edges);
+		return;
+	}
+	utils::AppendCosineSimilarityEdges(
+			GetContiguousTimeSeries(pixel_index, workspace), start_time,
+			end_time, utils::EPSILON, workspace.similarity, workspace.edges);
+}
+
+void PhenoNet::CollectNearestNeighborEdges(std::size_t pixel,
+		const std::vector<std::size_t> &min_giant_component_sizes,
+		PhenoWorkspace &workspace) const {
+	const int start_time = start_time_[pixel], end_time = end_time_[pixel];
+	const std::size_t num_time_slices = GetNumTimeSlices(pixel);
+	utils::BuildCosineSimilarityIndex(
+			GetContiguousTimeSeries(pixel, workspace), start_time, end_time,
+			workspace.similarity);
+	const int num_slices = std::max(end_time - start_time, 0);
+	std::vector<std::vector<Edge>> &nearest = workspace.nearest_edges;
+	nearest.resize(std::max<std::size_t>(nearest.size(), num_slices));
+	workspace.num_neighbors.assign(num_slices, nearest_neighbors_);
+	// Whether the neighbors of a time slice are (re)computed and whether they
+	// were cut off, i.e. some of its edges may be missing.
+	workspace.widen_neighbors.assign(num_slices, 1);
+	workspace.neighbors_cut_off.assign(num_slices, 0);
+	// The largest of the giant component sizes that may be reached.
+	std::size_t min_giant_component_size = 0;
+	bool reachable = false;
+	while (true) {
+		bool cut_off = false;
+		for (int t = 0; t < num_slices; ++t) {
+			if (workspace.widen_neighbors[t]) {
+				nearest[t].clear();
+				workspace.neighbors_cut_off[t] =
+						!utils::AppendNearestCosineSimilarityEdges(
+								start_time + t, utils::EPSILON,
+								workspace.num_neighbors[t],
+								workspace.similarity, nearest[t]);
+			}
+			cut_off = cut_off || workspace.neighbors_cut_off[t];
+		}
+		// Edges found from both of their time slices are kept once.
+		workspace.edges.clear();
+		for (int t = 0; t < num_slices; ++t) {
+			workspace.edges.insert(workspace.edges.end(), nearest[t].begin(),
+					nearest[t].end());
+		}
+		std::sort(workspace.edges.begin(), workspace.edges.end());
+		workspace.edges.erase(
+				std::unique(workspace.edges.begin(), workspace.edges.end()),
+				workspace.edges.end());
+		if (!cut_off) {
+			return;
+		}
+		if (!reachable) {
+			// The neighbors include the heaviest edge of every time slice, so
+			// they connect the same nodes as all pairs.
+			const std::size_t num_connected_nodes = CountConnectedNodes(
+					num_time_slices, workspace);
+			for (std::size_t size : min_giant_component_sizes) {
+				if (size <= num_connected_nodes
+						&& (!reachable || size > min_giant_component_size)) {
+					min_giant_component_size = size;
+					reachable = true;
+				}
+			}
+			if (!reachable) {
+				return;
+			}
+		}
+
+		// A missing edge is lighter than the last neighbor of both of its
+		// time slices. The network is complete if at most one time slice
+		// that was cut off has its last neighbor before the last connected
+		// edge, or none has if the giant component is not large enough yet.
+		simple_graph::utils::UnionFind &uf = workspace.union_find;
+		uf.Reset(num_time_slices);
+		EdgeOrder edge_order(workspace.edges,
+				edge_ordering_ == EdgeOrdering::kIncremental,
+				kInitialEdgeBatchPerTimeSlice * num_time_slices);
+		ConnectEdgesUntil(edge_order, min_giant_component_size, uf);
+		const bool connected = uf.GiantComponentSize()
+				>= min_giant_component_size;
+		const std::size_t num_connected = edge_order.GetNumHandedOut();
+		if (connected && num_connected == 0) {
+			return;
+		}
+		std::size_t num_widened = 0;
+		for (int t = 0; t < num_slices; ++t) {
+			workspace.widen_neighbors[t] = workspace.neighbors_cut_off[t]
+					&& (!connected
+							|| utils::IsHeavierEdge(nearest[t].back(),
+									workspace.edges[num_connected - 1]));
+			num_widened += workspace.widen_neighbors[t];
+		}
+		if (num_widened <= 1) {
+			return;
+		}
+		for (int t = 0; t < num_slices; ++t) {
+			if (workspace.widen_neighbors[t]) {
+				workspace.num_neighbors[t] *= 2;
 			}
-			float weight = utils::SimilarityCosine<float>(*slice1, *slice2);
-			if (weight >= utils::EPSILON) {
-				// Skips small values for performance optimization
-				edges.push_back( { { i, j }, weight });
-				connected_nodes.insert(i);
-				connected_nodes.insert(j);
+		}
+	}
+}
+
+std::size_t PhenoNet::GetNetworkSize(std::size_t pixel) const {
+	const int num_time_slices = GetNumTimeSlices(pixel);
+	const int start_time = start_time_[pixel], end_time = end_time_[pixel];
+	if (!windowed_networks_) {
+		return num_time_slices;
+	}
+	const int num_nodes_before = start_time > 0 ? 1 : 0;
+	const int num_nodes_after = end_time < num_time_slices ? 1 : 0;
+	return num_nodes_before + (end_time - start_time) + num_nodes_after;
+}
+
+std::size_t PhenoNet::GetNetworkSize(std::size_t pixel,
+		PhenoWorkspace &workspace, int &node_offset) const {
+	const int start_time = start_time_[pixel];
+	node_offset = 0;
+	if (windowed_networks_ && start_time > 0) {
+		// The candidate edges only connect time slices of the range.
+		node_offset = start_time - 1;
+		for (auto &edge : workspace.edges) {
+			edge.first.first -= node_offset;
+			edge.first.second -= node_offset;
+		}
+	}
+	return GetNetworkSize(pixel);
+}
+
+std::size_t PhenoNet::CountConnectedNodes(std::size_t num_time_slices,
+		PhenoWorkspace &workspace) const {
+	std::vector<char> &connected_nodes = workspace.connected_nodes;
+	connected_nodes.assign(num_time_slices, 0);
+	std::size_t num_connected_nodes = 0;
+	for (const auto &edge : workspace.edges) {
+		for (int node : { edge.first.first, edge.first.second }) {
+			if (!connected_nodes[node]) {
+				connected_nodes[node] = 1;
+				++num_connected_nodes;
 			}
 		}
 	}
-	if (connected_nodes.size() < min_giant_component_size) {
+	return num_connected_nodes;
+}
+
+const CompactNetwork& PhenoNet::BuildPhenoNetworkByGiantComponentSize(
+		std::size_t pixel, std::size_t network_size,
+		std::size_t min_giant_component_size,
+		PhenoWorkspace &workspace) const {
+	if (CountConnectedNodes(network_size, workspace)
+			< min_giant_component_size) {
 		// Returns an empty network since the min_giant_component_size cannot
 		// be met.
-		return Network(0);
+		workspace.network.Assign(0, workspace.edges, 0);
+		return workspace.network;
 	}
-	std::sort(edges.begin(), edges.end(),
-			[](const std::pair<std::pair<int, int>, float> &edge1,
-					const std::pair<std::pair<int, int>, float> &edge2) {
-				return edge1.second > edge2.second;
-			});
 	// Adds the edges to the pheno net based on their weights in descending
 	// order, until the desired minimum giant component size is reached.
-	Network net(num_time_slices);
-	simple_graph::utils::UnionFind uf(num_time_slices);
-	for (const auto &edge : edges) {
-		if (uf.GiantComponentSize() >= min_giant_component_size) {
-			break;
-		}
-		const int node1 = edge.first.first;
-		const int node2 = edge.first.second;
-		net.AddOrUpdateEdge(node1, node2, edge.second);
-		uf.Union(node1, node2);
+	// Usually only a small prefix of the edges is needed, so the incremental
+	// ordering avoids sorting all of them. The network is then built at once
+	// from the connected edges.
+	simple_graph::utils::UnionFind &uf = workspace.union_find;
+	uf.Reset(network_size);
+	EdgeOrder edge_order(workspace.edges,
+			edge_ordering_ == EdgeOrdering::kIncremental,
+			kInitialEdgeBatchPerTimeSlice * GetNumTimeSlices(pixel));
+	ConnectEdgesUntil(edge_order, min_giant_component_size, uf);
+	if (uf.GiantComponentSize() < min_giant_component_size) {
+		workspace.network.Assign(0, workspace.edges, 0);
+	} else {
+		workspace.network.Assign(network_size, workspace.edges,
+				edge_order.GetNumHandedOut());
 	}
-	return uf.GiantComponentSize() >= min_giant_component_size ?
-			net : Network(0);
+	return workspace.network;
 }
 
-bool PhenoNet::FindPeak(const TimeSeries<float> &time_series, int start_time,
-		int end_time, std::size_t min_giant_component_size,
-		int &time_slice_index, float &bridging_coefficient) {
-	const Network pheno_net = BuildPhenoNetworkByGiantComponentSize(time_series,
-			start_time, end_time, min_giant_component_size);
-	if (pheno_net.IsEmpty()) {
-		std::clog<<"The pheno network is too fragmented to meet the given "
-				<<"requirement\n";
-		return false;
+void PhenoNet::ComputeNodeMeasures(const CompactNetwork &pheno_net,
+		std::size_t num_time_slices, PhenoWorkspace &workspace,
+		std::vector<float> &betweenness, std::vector<float> &clustering,
+		std::vector<char> &giant_component) const {
+	simple_graph::utils::NetworkWorkspace &measures =
+			workspace.network_measures;
+	giant_component.assign(pheno_net.Size(), 0);
+	simple_graph::utils::ExtractGiantComponent(pheno_net, measures,
+			workspace.giant_nodes);
+	for (std::size_t node : workspace.giant_nodes) {
+		giant_component[node] = 1;
 	}
-	const std::vector<std::size_t> giant_component =
-			simple_graph::utils::ExtractGiantComponent(pheno_net);
-	const std::unordered_set<std::size_t> giant_nodes(giant_component.begin(),
-			giant_component.end());
-	std::vector<float> node_measures =
-			simple_graph::utils::GetNodeBetweennessCentrality(pheno_net);
-	for (std::size_t i = 0; i < pheno_net.Size(); ++i) {
-		if (giant_nodes.count(i) == 0) {
+	// For small networks, both measures are computed from the same adjacency
+	// matrix, which is built into the workspace.
+	const simple_graph::BitsetNetwork *adjacency = &measures.adjacency;
+	if (workspace.network_threads > 1) {
+		simple_graph::utils::GetNodeBetweennessCentrality(pheno_net,
+				num_time_slices, workspace.network_threads,
+				workspace.parallel_measures, betweenness);
+		adjacency = &workspace.parallel_measures.threads[0].adjacency;
+	} else {
+		simple_graph::utils::GetNodeBetweennessCentrality(pheno_net,
+				num_time_slices, measures, betweenness);
+	}
+	if (simple_graph::utils::UsesBitsetBetweenness(pheno_net.Size(),
+			num_time_slices)) {
+		simple_graph::utils::GetAllClusteringCoefficients(*adjacency,
+				clustering);
+	} else {
+		simple_graph::utils::GetAllClusteringCoefficients(pheno_net,
+				clustering);
+	}
+}
+
+const std::vector<float>& PhenoNet::GetBridgingCoefficients(
+		const CompactNetwork &pheno_net, std::size_t num_time_slices,
+		int node_offset, PhenoWorkspace &workspace) const {
+	ComputeNodeMeasures(pheno_net, num_time_slices, workspace,
+			workspace.betweenness, workspace.clustering,
+			workspace.giant_component);
+	std::vector<float> &bridging_coefficients =
+			workspace.bridging_coefficients;
+	GetBridgingCoefficients(workspace.betweenness, workspace.clustering,
+			workspace.giant_component, bridging_coefficients);
+	if (bridging_coefficients.size() == num_time_slices) {
+		return bridging_coefficients;
+	}
+	// The time slices outside of a windowed network are isolated nodes of
+	// the full one.
+	std::vector<float> &time_slice_measures = workspace.time_slice_measures;
+	time_slice_measures.assign(num_time_slices, 0);
+	std::copy(bridging_coefficients.begin(), bridging_coefficients.end(),
+			time_slice_measures.begin() + node_offset);
+	return time_slice_measures;
+}
+
+void PhenoNet::GetBridgingCoefficients(const std::vector<float> &betweenness,
+		const std::vector<float> &clustering,
+		const std::vector<char> &giant_component,
+		std::vector<float> &bridging_coefficients) const {
+	bridging_coefficients.assign(betweenness.begin(), betweenness.end());
+	for (std::size_t i = 0; i < bridging_coefficients.size(); ++i) {
+		if (!giant_component[i]) {
 			// Only considers nodes in the giant component (to exclude
 			// outliers).
-			node_measures[i] = 0;
+			bridging_coefficients[i] = 0;
 			break;
 		}
-		float clustering_coefficient =
-				simple_graph::utils::GetClusteringCoefficient(pheno_net, i);
+		const float clustering_coefficient = clustering[i];
 		if (clustering_coefficient < utils::EPSILON) {
-			node_measures[i] = 0;
+			bridging_coefficients[i] = 0;
 		} else {
-			node_measures[i] /= clustering_coefficient;
+			bridging_coefficients[i] /= clustering_coefficient;
 		}
 	}
+}
+
+bool PhenoNet::SelectPeak(const std::vector<float> &node_measures,
+		std::size_t moving_window_size, int start_time, int end_time,
+		int &time_slice_index, float &bridging_coefficient) const {
 	time_slice_index = utils::FindMaxValueIndexMovingAverage(
-			node_measures, moving_window_size_, start_time, end_time, /* min_value = */
+			node_measures, moving_window_size, start_time, end_time, /* min_value = */
 			0, /* max_value = */INT_MAX);
 	if (time_slice_index < 0
-			|| time_slice_index
-					>= static_cast<int>(time_series.GetNumTimeSlices())) {
+			|| time_slice_index >= static_cast<int>(node_measures.size())) {
 		return false;
 	}
 	bridging_coefficient = node_measures[time_slice_index];
 	return true;
 }
 
+bool PhenoNet::SelectBasePeak(std::size_t pixel, BaseNetworkData &base_network,
+		std::vector<float> &bridging_coefficients) const {
+	GetBridgingCoefficients(base_network.betweenness, base_network.clustering,
+			base_network.giant_component, bridging_coefficients);
+	return SelectPeak(bridging_coefficients, moving_window_size_,
+			start_time_[pixel], end_time_[pixel],
+			base_network.peak_time_slice_index,
+			base_network.peak_bridging_coefficient);
+}
+
+bool PhenoNet::FindPeak(const CompactNetwork &pheno_net,
+		std::size_t num_time_slices, int node_offset, int start_time,
+		int end_time, PhenoWorkspace &workspace, int &time_slice_index,
+		float &bridging_coefficient) const {
+	if (pheno_net.IsEmpty()) {
+		ReportFragmentedNetwork();
+		return false;
+	}
+	return SelectPeak(
+			GetBridgingCoefficients(pheno_net, num_time_slices, node_offset,
+					workspace), moving_window_size_, start_time, end_time,
+			time_slice_index, bridging_coefficient);
+}
+
+template<typename PixelAnalysis>
+void PhenoNet::ForEachPixel(
+		const std::vector<std::size_t> &min_giant_component_sizes,
+		PixelAnalysis analyze) {
+	const std::size_t num_pixels = GetNumPixels();
+	int num_threads = 1;
+#ifdef _OPENMP
+	num_threads = num_threads_ > 0 ? num_threads_ : omp_get_max_threads();
+#endif
+	// Quantized pixels and the nearest neighbors are computed one pixel at a
+	// time.
+	const bool nearest_neighbors = nearest_neighbors_ > 0 && !pixels_.empty();
+	// The pixels are handed out in groups of InterleavedPixelBlock::kLanes
+	// when their similarities can be computed together, unless there are
+	// fewer groups than threads. Otherwise they are handed out one at a
+	// time, which also balances cheap (rejected) and expensive pixels best.
+	const bool batching = pixel_batching_ && !pixels_.empty()
+			&& !nearest_neighbors;
+	std::size_t group_size = InterleavedPixelBlock::kLanes;
+	if (!batching
+			|| (num_pixels + group_size - 1) / group_size
+					< static_cast<std::size_t>(num_threads)) {
+		group_size = 1;
+	}
+	const int num_groups = static_cast<int>((num_pixels + group_size - 1)
+			/ group_size);
+	// The pixels that are analyzed with all threads per network. The
+	// betweenness centrality is the same either way.
+	std::vector<std::size_t> large_pixels;
+	std::vector<char> large_network(num_pixels, 0);
+	if (num_threads > 1) {
+		for (std::size_t i = 0; i < num_pixels; ++i) {
+			if (GetNetworkSize(i) >= kMinIntraNetworkParallelSize) {
+				large_pixels.push_back(i);
+			}
+		}
+		if (large_pixels.size() >= static_cast<std::size_t>(num_threads)) {
+			large_pixels.clear();
+		}
+		for (std::size_t i : large_pixels) {
+			large_network[i] = 1;
+		}
+	}
+	auto collect_edges = [&](std::size_t pixel, PhenoWorkspace &workspace) {
+		if (nearest_neighbors) {
+			CollectNearestNeighborEdges(pixel, min_giant_component_sizes,
+					workspace);
+		} else {
+			CollectCandidateEdges(pixel, start_time_[pixel], end_time_[pixel],
+					workspace);
+		}
+	};
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads) if (num_threads > 1)
+#endif
+	{
+		PhenoWorkspace workspace;
+		// Groups are handed out one at a time to keep the threads busy when
+		// cheap (rejected) and expensive pixels are mixed.
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+		for (int group = 0; group < num_groups; ++group) {
+			const std::size_t first_pixel = group * group_size;
+			const std::size_t last_pixel = std::min(first_pixel + group_size,
+					num_pixels);
+			// The pixels of a group share the similarity computation if they
+			// are analyzed over the same time range.
+			bool batched = group_size > 1;
+			for (std::size_t i = first_pixel; batched && i < last_pixel;
+					++i) {
+				batched = start_time_[i] == start_time_[first_pixel]
+						&& end_time_[i] == end_time_[first_pixel]
+						&& !large_network[i];
+			}
+			batched = batched
+					&& workspace.block.Load(pixels_, first_pixel);
+			if (batched) {
+				for (auto &edges : workspace.block_edges) {
+					edges.clear();
+				}
+				utils::AppendBlockCosineSimilarityEdges(workspace.block,
+						start_time_[first_pixel], end_time_[first_pixel],
+						utils::EPSILON, workspace.block_similarity,
+						workspace.block_edges);
+			}
+			for (std::size_t i = first_pixel; i < last_pixel; ++i) {
+				if (large_network[i]) {
+					continue;
+				}
+				if (batched) {
+					workspace.edges.swap(
+							workspace.block_edges[i - first_pixel]);
+				} else {
+					collect_edges(i, workspace);
+				}
+				analyze(i, workspace);
+			}
+		}
+	}
+
+	PhenoWorkspace workspace;
+	workspace.network_threads = num_threads;
+	for (std::size_t i : large_pixels) {
+		collect_edges(i, workspace);
+		analyze(i, workspace);
+	}
+}
+
 void PhenoNet::Process() {
-	std::size_t num_pixels = time_series_data_.size();
-	peak_index_.resize(num_pixels, INT_MAX);
-	for (std::size_t i = 0; i < num_pixels; ++i) {
+	// Each pixel writes its own slot of peak_index_, so no synchronization
+	// is needed.
+	peak_index_.assign(GetNumPixels(), INT_MAX);
+	ForEachPixel( { min_giant_component_size_ },
+			[this](std::size_t pixel, PhenoWorkspace &workspace) {
+		int node_offset = 0;
+		const std::size_t network_size = GetNetworkSize(pixel, workspace,
+				node_offset);
+		const CompactNetwork &pheno_net =
+				BuildPhenoNetworkByGiantComponentSize(pixel, network_size,
+						min_giant_component_size_, workspace);
 		int peak_index = -1;
 		float measure = 0;
-		if (FindPeak(time_series_data_[i], start_time_[i], end_time_[i],
-				min_giant_component_size_, peak_index, measure)) {
-			peak_index_[i] = peak_index;
+		if (FindPeak(pheno_net, GetNumTimeSlices(pixel), node_offset,
+				start_time_[pixel], end_time_[pixel], workspace, peak_index,
+				measure)) {
+			peak_index_[pixel] = peak_index;
+		}
+	});
+}
+
+void PhenoNet::ProcessSweep(
+		const std::vector<float> &min_giant_component_fractions,
+		const std::vector<std::size_t> &moving_window_sizes) {
+	std::vector<std::size_t> window_sizes = moving_window_sizes;
+	if (window_sizes.empty()) {
+		window_sizes.push_back(moving_window_size_);
+	}
+	const std::size_t num_windows = window_sizes.size();
+	const std::size_t num_thresholds = min_giant_component_fractions.size();
+	std::vector<std::size_t> giant_sizes(num_thresholds);
+	for (std::size_t k = 0; k < num_thresholds; ++k) {
+		giant_sizes[k] = GetMinGiantComponentSize(
+				min_giant_component_fractions[k]);
+	}
+	// Visits the thresholds from the smallest giant component size, so the
+	// network only grows.
+	std::vector<std::size_t> thresholds(num_thresholds);
+	for (std::size_t k = 0; k < num_thresholds; ++k) {
+		thresholds[k] = k;
+	}
+	std::stable_sort(thresholds.begin(), thresholds.end(),
+			[&giant_sizes](std::size_t k1, std::size_t k2) {
+				return giant_sizes[k1] < giant_sizes[k2];
+			});
+
+	const Peak no_peak = { INT_MAX, 0 };
+	sweep_peaks_.assign(GetNumPixels(),
+			std::vector<Peak>(num_thresholds * num_windows, no_peak));
+	ForEachPixel(giant_sizes,
+			[&](std::size_t pixel, PhenoWorkspace &workspace) {
+		const std::size_t num_time_slices =
+				GetNumTimeSlices(pixel);
+		int node_offset = 0;
+		const std::size_t network_size = GetNetworkSize(pixel, workspace,
+				node_offset);
+		const std::size_t num_connected_nodes = CountConnectedNodes(
+				network_size, workspace);
+		simple_graph::utils::UnionFind &uf = workspace.union_find;
+		uf.Reset(network_size);
+		EdgeOrder edge_order(workspace.edges,
+				edge_ordering_ == EdgeOrdering::kIncremental,
+				kInitialEdgeBatchPerTimeSlice * num_time_slices);
+		for (std::size_t k : thresholds) {
+			if (num_connected_nodes < giant_sizes[k]) {
+				break;
+			}
+			ConnectEdgesUntil(edge_order, giant_sizes[k], uf);
+			if (uf.GiantComponentSize() < giant_sizes[k]) {
+				// Larger thresholds cannot be met either.
+				break;
+			}
+			workspace.network.Assign(network_size, workspace.edges,
+					edge_order.GetNumHandedOut());
+			const std::vector<float> &node_measures = GetBridgingCoefficients(
+					workspace.network, num_time_slices, node_offset,
+					workspace);
+			for (std::size_t w = 0; w < num_windows; ++w) {
+				Peak &peak = sweep_peaks_[pixel][k * num_windows + w];
+				int peak_index = -1;
+				float measure = 0;
+				if (SelectPeak(node_measures, window_sizes[w],
+						start_time_[pixel], end_time_[pixel], peak_index,
+						measure)) {
+					peak.time_slice_index = peak_index;
+					peak.bridging_coefficient = measure;
+				}
+			}
+		}
+	});
+}
+
+void PhenoNet::BuildBaseNetworks() {
+	base_networks_.clear();
+	base_networks_.resize(GetNumPixels());
+	ForEachPixel( { min_giant_component_size_ },
+			[this](std::size_t pixel, PhenoWorkspace &workspace) {
+		std::unique_ptr<BaseNetwork> base(new BaseNetwork());
+		BaseNetworkData &data = base->data;
+		data.network = BuildPhenoNetworkByGiantComponentSize(pixel,
+				GetNumTimeSlices(pixel), min_giant_component_size_, workspace);
+		if (data.network.IsEmpty()) {
+			ReportFragmentedNetwork();
+			return;
+		}
+		ComputeNodeMeasures(data.network, data.network.Size(), workspace,
+				data.betweenness, data.clustering, data.giant_component);
+		if (!SelectBasePeak(pixel, data, workspace.bridging_coefficients)) {
+			return;
+		}
+		data.min_weight = 1;
+		for (std::size_t i = 0; i < data.network.Size(); ++i) {
+			const float *weights = data.network.GetNeighborWeights(i);
+			for (std::size_t k = 0; k < data.network.GetDegree(i); ++k) {
+				data.min_weight = std::min(data.min_weight, weights[k]);
+			}
+		}
+		base_networks_[pixel] = std::move(base);
+	});
+}
+
+bool PhenoNet::SaveBaseNetworks(const std::string &path) const {
+	std::vector<const BaseNetworkData*> base_networks(base_networks_.size(),
+			nullptr);
+	for (std::size_t p = 0; p < base_networks_.size(); ++p) {
+		if (base_networks_[p])
+			base_networks[p] = &base_networks_[p]->data;
+	}
+	return BaseNetworkCache::Write(path, base_networks);
+}
+
+bool PhenoNet::LoadBaseNetworks(const std::string &path,
+		std::size_t first_pixel) {
+	base_networks_.clear();
+	base_networks_.resize(GetNumPixels());
+	BaseNetworkCache cache;
+	if (!cache.Open(path, first_pixel, GetNumPixels())) {
+		return false;
+	}
+	std::vector<float> bridging_coefficients;
+	for (std::size_t p = 0; p < GetNumPixels(); ++p) {
+		std::unique_ptr<BaseNetwork> base(new BaseNetwork());
+		if (!cache.Read(p, base->data)) {
+			continue;
+		}
+		if (base->data.network.Size()
+				!= GetNumTimeSlices(p)) {
+			std::cerr << "the base network of pixel " << first_pixel + p
+					<< " has " << base->data.network.Size()
+					<< " nodes v.s. time slices: "
+					<< GetNumTimeSlices(p) << std::endl;
+			continue;
+		}
+		if (!SelectBasePeak(p, base->data, bridging_coefficients)) {
+			continue;
+		}
+		base_networks_[p] = std::move(base);
+	}
+	return true;
+}
+
+bool PhenoNet::AddRealTimeNode(std::size_t pixel,
+		const std::vector<float> &time_slice, float &bridging_coefficient) {
+	if (pixel >= base_networks_.size() || !base_networks_[pixel]) {
+		std::cerr << "no base network for pixel: " << pixel << std::endl;
+		return false;
+	}
+	BaseNetwork &base = *base_networks_[pixel];
+	const std::size_t num_bands =
+			!pixels_.empty() ?
+					pixels_[pixel].GetTimeSliceDimension() :
+					quantization_.scales.size();
+	if (time_slice.size() != num_bands) {
+		std::cerr << "invalid time slice dimension: " << time_slice.size()
+				<< " v.s. " << num_bands << std::endl;
+		return false;
+	}
+	const float min_weight = base.data.min_weight;
+	std::vector<std::size_t> neighbors;
+	std::vector<float> buffer(time_slice.size());
+	for (int i = start_time_[pixel]; i < end_time_[pixel]; ++i) {
+		if (utils::SimilarityCosine(time_slice,
+				GetTimeSlice(pixel, i, buffer.data())) >= min_weight) {
+			neighbors.push_back(i);
 		}
 	}
+	const std::size_t num_base_nodes = GetNumTimeSlices(pixel);
+	for (std::size_t k = 0; k < base.added_time_slices.size(); ++k) {
+		if (utils::SimilarityCosine(time_slice, base.added_time_slices[k])
+				>= min_weight) {
+			neighbors.push_back(num_base_nodes + k);
+		}
+	}
+	if (!base.incremental) {
+		base.incremental.reset(
+				new simple_graph::IncrementalNetwork(base.data.network));
+	}
+	simple_graph::IncrementalNetwork &network = *base.incremental;
+	const std::size_t node = network.AddNode(neighbors);
+	base.added_time_slices.push_back(time_slice);
+
+	bridging_coefficient = 0;
+	const std::vector<std::size_t> giant_component =
+			network.ExtractGiantComponent();
+	if (!std::binary_search(giant_component.begin(), giant_component.end(),
+			node)) {
+		return true;
+	}
+	const float clustering_coefficient =
+			network.GetAllClusteringCoefficients()[node];
+	if (clustering_coefficient >= utils::EPSILON) {
+		// Normalized like the betweenness of the base network, so that the
+		// bridging coefficients can be compared.
+		bridging_coefficient = network.GetNodeBetweennessCentrality(
+				num_base_nodes)[node] / clustering_coefficient;
+	}
+	return true;
+}
+
+void PhenoNet::ResetRealTimeNodes(std::size_t pixel) {
+	if (pixel >= base_networks_.size() || !base_networks_[pixel]) {
+		return;
+	}
+	BaseNetwork &base = *base_networks_[pixel];
+	base.incremental.reset();
+	std::vector<std::vector<float>>().swap(base.added_time_slices);
+}
+
+bool PhenoNet::GetBasePeak(std::size_t pixel, Peak &peak) const {
+	if (pixel >= base_networks_.size() || !base_networks_[pixel]) {
+		return false;
+	}
+	peak.time_slice_index = base_networks_[pixel]->data.peak_time_slice_index;
+	peak.bridging_coefficient =
+			base_networks_[pixel]->data.peak_bridging_coefficient;
+	return true;
 }
 
 } /* namespace remote_sensing */
@@ -8,28 +8,257 @@
 #define SIMPLEGRAPH_PHENONET_PHENONET_H_
 
 #include "TimeSeries.h"
-#include "Network.h"
+#include "CompactNetwork.h"
+#include "NetworkUtils.h"
+#include "IncrementalNetwork.h"
+#include "BaseNetworkCache.h"
+#include "SimilarityKernel.h"
+#include "PixelBlock.h"
 
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace remote_sensing {
 
 class PhenoNet {
 public:
+	// How the candidate edges are ordered by weight while building a pheno
+	// network. Both produce identical networks.
+	enum class EdgeOrdering {
+		// Sorts all edges.
+		kFullSort,
+		// Selects and sorts the heaviest remaining edges in growing batches
+		// and stops as soon as the giant component is large enough.
+		kIncremental
+	};
+
 	PhenoNet(std::vector<TimeSeries<float>> &&pixel_time_series,
 			float min_giant_component_fraction);
 
+	// Analyzes pixels whose values are stored elsewhere, e.g. the views of a
+	// MappedCube, in place: no TimeSeries is built. The viewed values must
+	// outlive this object.
+	PhenoNet(std::vector<PixelView<float>> &&pixels,
+			float min_giant_component_fraction);
+
+	// Analyzes quantized time series (e.g. scaled int16 reflectance) without
+	// decoding them, at half the memory of float: the similarities are
+	// computed on the stored integers (see utils::AppendCosineSimilarityEdges)
+	// and the pixels are processed one at a time. The quantization must have
+	// one scale and offset per band.
+	PhenoNet(std::vector<TimeSeries<std::int16_t>> &&pixel_time_series,
+			const BandQuantization &quantization,
+			float min_giant_component_fraction);
+	PhenoNet(std::vector<TimeSeries<std::uint16_t>> &&pixel_time_series,
+			const BandQuantization &quantization,
+			float min_giant_component_fraction);
+
 	virtual ~PhenoNet();
 	PhenoNet(const PhenoNet &other) = delete;
 	PhenoNet& operator=(const PhenoNet &other) = delete;
 
+	// Finds the peak of every pixel. Pixels are processed in parallel with
+	// OpenMP (when enabled at compile time) using dynamic scheduling, since
+	// the cost per pixel varies a lot: fragmented pixels are rejected early
+	// while valid ones run the full network analysis. The results do not
+	// depend on the number of threads.
 	void Process();
+
+	// Sets the number of threads used by Process(). 0 (the default) uses
+	// the OpenMP default (e.g. OMP_NUM_THREADS), 1 runs serially.
+	void SetNumThreads(int num_threads) {
+		num_threads_ = num_threads < 0 ? 0 : num_threads;
+	}
+
+	// Enables (the default) or disables computing the similarities of
+	// groups of InterleavedPixelBlock::kLanes pixels at once. Groups whose
+	// pixels have different time ranges always fall back to one pixel at a
+	// time, and so do all pixels if there are fewer groups than threads
+	// (the threads are then kept busy one pixel at a time instead). The
+	// results are the same either way.
+	void SetPixelBatching(bool enabled) {
+		pixel_batching_ = enabled;
+	}
+
+	// The default is EdgeOrdering::kIncremental.
+	void SetEdgeOrdering(EdgeOrdering edge_ordering) {
+		edge_ordering_ = edge_ordering;
+	}
+
+	// Sets the number of nearest neighbors of every time slice that are
+	// computed as candidate edges at first (see
+	// utils::AppendNearestCosineSimilarityEdges()), instead of the similarity
+	// of all pairs of time slices, which is quadratic in time and memory for
+	// long time series. The number is doubled for the time slices whose
+	// missing edges might belong to the pheno network, until none can, so
+	// the networks are the same as with all pairs. 0 (the default) computes
+	// all pairs, which is faster for a year of daily time slices. Quantized
+	// pixels always use all pairs.
+	void SetNearestNeighbors(std::size_t k) {
+		nearest_neighbors_ = k;
+	}
+
+	// Restricts the analysis of a pixel to the time slices [start_time,
+	// end_time), e.g. to its growing season from a crop calendar. The
+	// default is all time slices. Returns false if the range is invalid.
+	bool SetTimeRange(std::size_t pixel, int start_time, int end_time);
+
+	// Enables or disables (the default) windowed pheno networks: the network
+	// of a pixel only has nodes for the time slices of its time range (and
+	// one isolated node for the time slices before and after it), so the
+	// network analysis costs time in proportion to the length of the range
+	// rather than of the whole time series. The peaks are mapped back to the
+	// time slice indices and are the same either way, since the betweenness
+	// centrality is computed with the algorithm for the size of the full
+	// network (see simple_graph::utils::UsesBitsetBetweenness()). Base
+	// networks (see BuildBaseNetworks()) always have a node per time slice.
+	void SetWindowedNetworks(bool enabled) {
+		windowed_networks_ = enabled;
+	}
+
 	std::vector<int> GetPeakTimeSliceIndex() const {
 		return peak_index_;
 	}
 
+	// The peak found for one parameter combination of a sweep.
+	struct Peak {
+		// INT_MAX if no peak was found.
+		int time_slice_index;
+		float bridging_coefficient;
+	};
+
+	// Finds the peak of every pixel for every combination of the given
+	// minimum giant component fractions and moving window sizes (the
+	// default window size if empty). The pheno network for a smaller
+	// fraction is a prefix (in edges) of the one for a larger fraction, so
+	// the candidate edges of each pixel are computed and ordered once and the
+	// growing network is analyzed at each threshold. The results match
+	// running Process() once per combination.
+	void ProcessSweep(const std::vector<float> &min_giant_component_fractions,
+			const std::vector<std::size_t> &moving_window_sizes);
+
+	// Returns the results of ProcessSweep(). The peak of pixel p for the
+	// fraction f and the window size w is stored at
+	// [p][f * num_window_sizes + w].
+	const std::vector<std::vector<Peak>>& GetSweepPeaks() const {
+		return sweep_peaks_;
+	}
+
+	// Adaptive node addition: instead of rebuilding the pheno network when a
+	// new observation arrives, it is added as a node to a base network whose
+	// node measures are updated incrementally (see
+	// simple_graph::IncrementalNetwork). BuildBaseNetworks() builds the pheno
+	// network of every pixel, finds its peak and keeps it as the base network
+	// of the pixel. The incremental state of a base network (20 bytes per
+	// pair of time slices, about 2.7 MB for 365 time slices) is only built by
+	// its first AddRealTimeNode() and is kept until ResetRealTimeNodes(), so
+	// only the pixels that are being updated should have one.
+	void BuildBaseNetworks();
+
+	// Writes the base networks to a cache file (see BaseNetworkCache), so
+	// that later runs can load them instead of building them. Returns false
+	// if the file cannot be written.
+	bool SaveBaseNetworks(const std::string &path) const;
+
+	// Loads the base networks of the pixels from a cache file, in which they
+	// are stored from first_pixel on. Only that range of the file is mapped.
+	// The networks and their measures are not recomputed: the peaks are
+	// selected from the cached measures, with the current moving window and
+	// time ranges. The incremental state is not cached (see above), so the
+	// first AddRealTimeNode() of a pixel still searches from every node.
+	// Returns false if the file cannot be read.
+	bool LoadBaseNetworks(const std::string &path, std::size_t first_pixel);
+
+	// Adds a new observation (one value per band) to the base network of the
+	// pixel. The new node is connected to the nodes of the time range and
+	// the previously added nodes that are at least as similar as the weakest
+	// edge of the base network. bridging_coefficient receives the bridging
+	// coefficient of the new node (0 outside of the giant component), to be
+	// compared with the one of the peak of the base network: its betweenness
+	// centrality is normalized by the size of the base network as well.
+	// Returns false if the pixel has no base network or the observation is
+	// invalid.
+	bool AddRealTimeNode(std::size_t pixel, const std::vector<float> &time_slice,
+			float &bridging_coefficient);
+
+	// Removes the nodes added to the base network of the pixel and frees its
+	// incremental state.
+	void ResetRealTimeNodes(std::size_t pixel);
+
+	// Returns the peak (the transition cluster) of the base network of the
+	// pixel. Returns false if the pixel has no base network.
+	bool GetBasePeak(std::size_t pixel, Peak &peak) const;
+
 private:
+	typedef utils::WeightedEdge Edge;
+
+	// Per thread buffers that are reused from pixel to pixel. They only grow
+	// (to the largest pixel seen so far), so the analysis of a pixel does not
+	// allocate once a thread has warmed up, and each of them is reset by the
+	// function that uses it (in proportion to what it touches).
+	struct PhenoWorkspace {
+		PhenoWorkspace() :
+				union_find(0), network_threads(1) {
+		}
+
+		std::vector<Edge> edges;
+		utils::SimilarityWorkspace similarity;
+		std::vector<char> connected_nodes;
+		InterleavedPixelBlock block;
+		utils::BlockSimilarityWorkspace block_similarity;
+		std::vector<std::vector<Edge>> block_edges;
+		// The values of a pixel whose view is not contiguous.
+		std::vector<float> pixel_values;
+		// The nearest neighbor edges of each time slice of the time range,
+		// their number and whether they are widened and were cut off (see
+		// CollectNearestNeighborEdges()).
+		std::vector<std::vector<Edge>> nearest_edges;
+		std::vector<std::size_t> num_neighbors;
+		std::vector<char> widen_neighbors;
+		std::vector<char> neighbors_cut_off;
+		// The connected components of the growing pheno network and the
+		// network built from its connected edges.
+		simple_graph::utils::UnionFind union_find;
+		simple_graph::CompactNetwork network;
+		// The node measures of the network and their buffers (see
+		// ComputeNodeMeasures()).
+		simple_graph::utils::NetworkWorkspace network_measures;
+		// The number of threads that compute the betweenness centrality of
+		// one network together (see ForEachPixel()), and their buffers.
+		int network_threads;
+		simple_graph::utils::ParallelNetworkWorkspace parallel_measures;
+		std::vector<std::size_t> giant_nodes;
+		std::vector<char> giant_component;
+		std::vector<float> betweenness;
+		std::vector<float> clustering;
+		// The bridging coefficients of the nodes and of the time slices (see
+		// GetBridgingCoefficients()).
+		std::vector<float> bridging_coefficients;
+		std::vector<float> time_slice_measures;
+	};
+
+	// The base network of a pixel for the adaptive node addition. New nodes
+	// are connected to the nodes that are at least data.min_weight similar.
+	struct BaseNetwork {
+		BaseNetworkData data;
+		// Built from data.network when the first node is added.
+		std::unique_ptr<simple_graph::IncrementalNetwork> incremental;
+		// The time slices of the nodes added so far.
+		std::vector<std::vector<float>> added_time_slices;
+	};
+
+	// The time series given to the constructor, if any.
 	std::vector<TimeSeries<float>> time_series_data_;
+	// The views of the pixels, of time_series_data_ or of the values of the
+	// caller.
+	std::vector<PixelView<float>> pixels_;
+	// The quantized time series given to the constructor, if any, and their
+	// encoding. pixels_ is empty then.
+	std::vector<TimeSeries<std::int16_t>> int16_data_;
+	std::vector<TimeSeries<std::uint16_t>> uint16_data_;
+	BandQuantization quantization_;
 	// The ranges of the time series that will be considered for
 	// calculations. end_time_ is exclusive. The default is all time
 	// slices.
@@ -46,22 +275,129 @@ private:
 	std::size_t moving_window_size_;
 	// The index of the peak nodes (of the time slices).
 	std::vector<int> peak_index_;
+	// The number of threads used by Process(). 0 means the OpenMP default.
+	int num_threads_;
+	// Whether the similarities are computed for groups of pixels at once.
+	bool pixel_batching_;
+	EdgeOrdering edge_ordering_;
+	// Whether the pheno networks are limited to the time ranges.
+	bool windowed_networks_;
+	// The initial number of nearest neighbors of the candidate edges, 0 for
+	// all pairs.
+	std::size_t nearest_neighbors_;
+
+	// The peaks found by ProcessSweep().
+	std::vector<std::vector<Peak>> sweep_peaks_;
+	// The base networks built by BuildBaseNetworks(), nullptr for the pixels
+	// without a peak.
+	std::vector<std::unique_ptr<BaseNetwork>> base_networks_;
 
-	// Builds a pheno network. Iteratively connect nodes based on their cosine
+	// Sets the default time ranges and thresholds of the pixels.
+	void Initialize(float min_giant_component_fraction);
+	// The number of pixels, either views or quantized.
+	std::size_t GetNumPixels() const;
+	std::size_t GetNumTimeSlices(std::size_t pixel) const;
+	// Returns a time slice of a pixel, which is decoded or gathered into
+	// buffer (one value per band) if needed.
+	TimeSlice<float> GetTimeSlice(std::size_t pixel, std::size_t time_slice_index,
+			float *buffer) const;
+	// Converts a fraction of the time slices to a giant component size.
+	std::size_t GetMinGiantComponentSize(
+			float min_giant_component_fraction) const;
+	// Returns the time series of a pixel, which is gathered into
+	// workspace.pixel_values if its view is not contiguous.
+	TimeSeries<float> GetContiguousTimeSeries(std::size_t pixel,
+			PhenoWorkspace &workspace) const;
+	// Computes the candidate edges of a pheno network, i.e. the cosine
+	// similarity between all pairs of time slices, into workspace.edges.
+	void CollectCandidateEdges(std::size_t pixel, int start_time,
+			int end_time, PhenoWorkspace &workspace) const;
+	// Computes the nearest neighbor candidate edges of a pixel into
+	// workspace.edges, widening the neighbors until the edges that are
+	// connected to reach a giant component of the largest of
+	// min_giant_component_sizes that the pixel has enough connected nodes
+	// for are the same as with all pairs.
+	void CollectNearestNeighborEdges(std::size_t pixel,
+			const std::vector<std::size_t> &min_giant_component_sizes,
+			PhenoWorkspace &workspace) const;
+	// Returns the size of the pheno network of a pixel. The time slices
+	// before and after the time range of a windowed network, if any, are
+	// represented by one isolated node each, which keeps the order of the
+	// connected components the same as in the full network.
+	std::size_t GetNetworkSize(std::size_t pixel) const;
+	// The same, re-indexing the candidate edges in workspace.edges of
+	// windowed networks so that node i stands for the time slice i +
+	// node_offset.
+	std::size_t GetNetworkSize(std::size_t pixel, PhenoWorkspace &workspace,
+			int &node_offset) const;
+	// Returns the number of nodes with at least one candidate edge.
+	std::size_t CountConnectedNodes(std::size_t num_time_slices,
+			PhenoWorkspace &workspace) const;
+	// Builds a pheno network from the candidate edges in workspace.edges.
+	// Iteratively connect nodes based on their cosine
 	// similarity from high (most similar) to low (least similar).
 	// Once the giant component reaches the desired size
 	// (min_gaint_component_size), the connection stops, i.e. the least
 	// similar nodes are not connected in the network.
-	// Returns an empty network if the requirement cannot be met.
-	simple_graph::Network BuildPhenoNetworkByGiantComponentSize(
-			const TimeSeries<float> &time_series, int start_time, int end_time,
-			std::size_t min_gaint_component_size);
-	// Finds the peak (transition) point of the given time series. The peak
+	// Returns an empty network if the requirement cannot be met. The network
+	// has network_size nodes (see GetNetworkSize()) and is stored in
+	// workspace.network.
+	const simple_graph::CompactNetwork& BuildPhenoNetworkByGiantComponentSize(
+			std::size_t pixel, std::size_t network_size,
+			std::size_t min_gaint_component_size,
+			PhenoWorkspace &workspace) const;
+	// Computes the measures the bridging coefficients are derived from.
+	// giant_component receives 1 for the nodes of the giant component. The
+	// betweenness centrality is normalized for num_time_slices nodes.
+	void ComputeNodeMeasures(const simple_graph::CompactNetwork &pheno_net,
+			std::size_t num_time_slices, PhenoWorkspace &workspace,
+			std::vector<float> &betweenness, std::vector<float> &clustering,
+			std::vector<char> &giant_component) const;
+	// Returns the bridging coefficient of every time slice, i.e. the
+	// betweenness centrality of its node divided by its clustering
+	// coefficient. Node i of the network stands for the time slice i +
+	// node_offset, and the other time slices get 0. The result is stored in
+	// the workspace.
+	const std::vector<float>& GetBridgingCoefficients(
+			const simple_graph::CompactNetwork &pheno_net,
+			std::size_t num_time_slices, int node_offset,
+			PhenoWorkspace &workspace) const;
+	// The same, into bridging_coefficients, from the measures computed by
+	// ComputeNodeMeasures().
+	void GetBridgingCoefficients(const std::vector<float> &betweenness,
+			const std::vector<float> &clustering,
+			const std::vector<char> &giant_component,
+			std::vector<float> &bridging_coefficients) const;
+	// Selects the peak as the node with the highest moving average of the
+	// node measures. Returns false if no peak could be found.
+	bool SelectPeak(const std::vector<float> &node_measures,
+			std::size_t moving_window_size, int start_time, int end_time,
+			int &time_slice_index, float &bridging_coefficient) const;
+	// Selects the peak of the base network of the pixel from its measures,
+	// with the moving window and time range of the pixel.
+	bool SelectBasePeak(std::size_t pixel, BaseNetworkData &base_network,
+			std::vector<float> &bridging_coefficients) const;
+	// Finds the peak (transition) point of the given pheno network. The peak
 	// is selected as the node with the highest bridging coeficient. Returns
 	// false if no algorithm defined peak could not found.
-	bool FindPeak(const TimeSeries<float> &time_series, int start_time,
-			int end_time, std::size_t min_gaint_component_size,
-			int &time_slice_index, float &bridging_coefficient);
+	bool FindPeak(const simple_graph::CompactNetwork &pheno_net,
+			std::size_t num_time_slices, int node_offset, int start_time,
+			int end_time, PhenoWorkspace &workspace, int &time_slice_index,
+			float &bridging_coefficient) const;
+	// Computes the candidate edges of every pixel and calls
+	// analyze(pixel, workspace) with them in workspace.edges. Pixels are
+	// handed out to the threads in groups of InterleavedPixelBlock::kLanes
+	// if they are batched and there are enough groups for the threads, and
+	// one at a time otherwise. The
+	// nearest neighbor candidate edges are complete up to the giant
+	// component sizes the analysis needs (see CollectNearestNeighborEdges()).
+	// If only a few pixels have networks of at least
+	// kMinIntraNetworkParallelSize nodes, fewer than the threads, they are
+	// analyzed afterwards one at a time, and all threads compute the
+	// betweenness centrality of each of their networks instead.
+	template<typename PixelAnalysis>
+	void ForEachPixel(const std::vector<std::size_t> &min_giant_component_sizes,
+			PixelAnalysis analyze);
 };
 
 } /* namespace remote_sensing */
@@ -0,0 +1,178 @@
+/*
+ * PixelBlock.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "PixelBlock.h"
+
+#include "Simd.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace remote_sensing {
+
+constexpr std::size_t InterleavedPixelBlock::kLanes;
+
+void InterleavedPixelBlock::Resize(std::size_t num_pixels,
+		std::size_t num_time_slices, std::size_t num_bands) {
+	num_pixels_ = num_pixels;
+	num_time_slices_ = num_time_slices;
+	num_bands_ = num_bands;
+	values_.assign(num_time_slices * num_bands * kLanes, 0);
+}
+
+bool InterleavedPixelBlock::Load(const std::vector<PixelView<float>> &pixels,
+		std::size_t first_pixel) {
+	if (first_pixel >= pixels.size()) {
+		return false;
+	}
+	const std::size_t num_pixels = std::min(kLanes,
+			pixels.size() - first_pixel);
+	const std::size_t num_time_slices = pixels[first_pixel].GetNumTimeSlices();
+	const std::size_t num_bands = pixels[first_pixel].GetTimeSliceDimension();
+	for (std::size_t lane = 1; lane < num_pixels; ++lane) {
+		const PixelView<float> &pixel = pixels[first_pixel + lane];
+		if (pixel.GetNumTimeSlices() != num_time_slices
+				|| pixel.GetTimeSliceDimension() != num_bands) {
+			return false;
+		}
+	}
+	Resize(num_pixels, num_time_slices, num_bands);
+	for (std::size_t lane = 0; lane < num_pixels; ++lane) {
+		const PixelView<float> &pixel = pixels[first_pixel + lane];
+		float *values = &values_[lane];
+		for (std::size_t t = 0; t < num_time_slices; ++t) {
+			for (std::size_t b = 0; b < num_bands; ++b) {
+				*values = pixel(t, b);
+				values += kLanes;
+			}
+		}
+	}
+	return true;
+}
+
+namespace utils {
+
+namespace {
+
+constexpr std::size_t kLanes = InterleavedPixelBlock::kLanes;
+static_assert(kLanes % simd::kLanes == 0,
+		"The block must hold a whole number of SIMD vectors");
+static_assert(kLanes <= sizeof(unsigned int) * 8,
+		"The valid lanes must fit in a bit mask");
+
+// Computes the similarity of the time slices i and j of all lanes.
+template<std::size_t NumBands>
+void ComputePair(const InterleavedPixelBlock &block, std::size_t i,
+		std::size_t j, const float *norms, float *weights) {
+	const std::size_t num_bands = GetNumBands<NumBands>(block.GetNumBands());
+	const float *norms_i = norms + i * kLanes;
+	const float *norms_j = norms + j * kLanes;
+#ifdef SIMD_ENABLED
+	for (std::size_t lane = 0; lane < kLanes; lane += simd::kLanes) {
+		simd::VectorF acc = simd::Zero();
+		for (std::size_t b = 0; b < num_bands; ++b) {
+			acc = simd::MultiplyAdd(acc,
+					simd::Load(block.GetValues(i, b) + lane),
+					simd::Load(block.GetValues(j, b) + lane));
+		}
+		simd::Store(weights + lane,
+				simd::Divide(simd::Divide(acc, simd::Load(norms_i + lane)),
+						simd::Load(norms_j + lane)));
+	}
+#else
+	std::fill(weights, weights + kLanes, 0.0f);
+	for (std::size_t b = 0; b < num_bands; ++b) {
+		const float *values_i = block.GetValues(i, b);
+		const float *values_j = block.GetValues(j, b);
+		for (std::size_t lane = 0; lane < kLanes; ++lane) {
+			weights[lane] += values_i[lane] * values_j[lane];
+		}
+	}
+	for (std::size_t lane = 0; lane < kLanes; ++lane) {
+		weights[lane] = weights[lane] / norms_i[lane] / norms_j[lane];
+	}
+#endif
+}
+
+// AppendBlockCosineSimilarityEdges() for NumBands bands (any number if 0).
+template<std::size_t NumBands>
+struct BlockCosineSimilarityKernel {
+	static void Run(const InterleavedPixelBlock &block, int start_time,
+			int end_time, float min_weight, BlockSimilarityWorkspace &workspace,
+			std::vector<std::vector<WeightedEdge>> &edges);
+};
+
+template<std::size_t NumBands>
+void BlockCosineSimilarityKernel<NumBands>::Run(
+		const InterleavedPixelBlock &block, int start_time, int end_time,
+		float min_weight, BlockSimilarityWorkspace &workspace,
+		std::vector<std::vector<WeightedEdge>> &edges) {
+	start_time = std::max(start_time, 0);
+	end_time = std::min(end_time,
+			static_cast<int>(block.GetNumTimeSlices()));
+	if (end_time - start_time < 2) {
+		return;
+	}
+	const std::size_t num_pixels = block.GetNumPixels();
+	const std::size_t num_bands = GetNumBands<NumBands>(block.GetNumBands());
+
+	// Computes the norm of every time slice of every lane.
+	workspace.norms.assign(block.GetNumTimeSlices() * kLanes, 1);
+	workspace.valid_lanes.assign(block.GetNumTimeSlices(), 0);
+	workspace.weights.resize(kLanes);
+	for (int t = start_time; t < end_time; ++t) {
+		for (std::size_t lane = 0; lane < num_pixels; ++lane) {
+			float sum = 0;
+			for (std::size_t b = 0; b < num_bands; ++b) {
+				const float value = block.GetValues(t, b)[lane];
+				sum += value * value;
+			}
+			if (sum > EPSILON) {
+				workspace.norms[t * kLanes + lane] = std::sqrt(sum);
+				workspace.valid_lanes[t] |= 1u << lane;
+			}
+		}
+	}
+
+	// Pairs with an invalid slice have a similarity of 0.
+	const bool keep_invalid_pairs = 0.0f >= min_weight;
+	float *weights = workspace.weights.data();
+	for (int i = start_time; i < end_time; ++i) {
+		for (int j = i + 1; j < end_time; ++j) {
+			const unsigned int valid_pair = workspace.valid_lanes[i]
+					& workspace.valid_lanes[j];
+			if (valid_pair == 0 && !keep_invalid_pairs) {
+				continue;
+			}
+			ComputePair<NumBands>(block, i, j, workspace.norms.data(), weights);
+			for (std::size_t lane = 0; lane < num_pixels; ++lane) {
+				const float weight =
+						(valid_pair >> lane) & 1u ? weights[lane] : 0.0f;
+				if (weight >= min_weight) {
+					edges[lane].push_back( { { i, j }, weight });
+				}
+			}
+		}
+	}
+}
+
+} /* namespace */
+
+void AppendBlockCosineSimilarityEdges(const InterleavedPixelBlock &block,
+		int start_time, int end_time, float min_weight,
+		BlockSimilarityWorkspace &workspace,
+		std::vector<std::vector<WeightedEdge>> &edges) {
+	if (edges.size() < kLanes) {
+		edges.resize(kLanes);
+	}
+	DispatchNumBands<BlockCosineSimilarityKernel>(block.GetNumBands(), block,
+			start_time, end_time, min_weight, workspace, edges);
+}
+
+} /* namespace utils */
+
+} /* namespace remote_sensing */
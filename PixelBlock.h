@@ -0,0 +1,97 @@
+/*
+ * PixelBlock.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_PHENONET_PIXELBLOCK_H_
+#define SIMPLEGRAPH_PHENONET_PIXELBLOCK_H_
+
+#include "TimeSeries.h"
+#include "SimilarityKernel.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace remote_sensing {
+
+// The time series of a group of up to kLanes pixels, interleaved so that the
+// values of one (time slice, band) are contiguous across the pixels (lanes):
+// value(time_slice, band, lane) is stored at
+// values_[(time_slice * num_bands + band) * kLanes + lane].
+// Since every pixel uses the same (i, j) time slice pairs, this layout lets
+// the similarity kernel fill a whole SIMD register with one pair of many
+// pixels instead of a few bands of one pixel. Unused lanes are zero.
+class InterleavedPixelBlock {
+public:
+	static constexpr std::size_t kLanes = 16;
+
+	InterleavedPixelBlock() :
+			num_pixels_(0), num_time_slices_(0), num_bands_(0) {
+	}
+
+	// Loads the pixels [first_pixel, first_pixel + kLanes) (fewer at the end
+	// of the input). The strided values of the views are gathered straight
+	// into the block. Returns false if there is no pixel to load or if the
+	// pixels do not have the same dimensions.
+	bool Load(const std::vector<PixelView<float>> &pixels,
+			std::size_t first_pixel);
+
+	// The number of loaded pixels (used lanes).
+	inline std::size_t GetNumPixels() const {
+		return num_pixels_;
+	}
+
+	inline std::size_t GetNumTimeSlices() const {
+		return num_time_slices_;
+	}
+
+	inline std::size_t GetNumBands() const {
+		return num_bands_;
+	}
+
+	// Returns the kLanes values of the given time slice and band.
+	inline const float* GetValues(std::size_t time_slice,
+			std::size_t band) const {
+		return &values_[(time_slice * num_bands_ + band) * kLanes];
+	}
+
+private:
+	std::size_t num_pixels_;
+	std::size_t num_time_slices_;
+	std::size_t num_bands_;
+	std::vector<float> values_;
+
+	void Resize(std::size_t num_pixels, std::size_t num_time_slices,
+			std::size_t num_bands);
+};
+
+namespace utils {
+
+// Buffers used by AppendBlockCosineSimilarityEdges(). Reuse them (e.g. one
+// per thread) to avoid reallocations.
+struct BlockSimilarityWorkspace {
+	// The norm of each time slice of each lane, [time_slice][lane].
+	std::vector<float> norms;
+	// The lanes with a valid (non zero) time slice, as a bit mask per slice.
+	std::vector<unsigned int> valid_lanes;
+	// The similarities of one pair of time slices for all lanes.
+	std::vector<float> weights;
+};
+
+// Computes the cosine similarity of all pairs of time slices (i, j),
+// start_time <= i < j < end_time, for all pixels of the block at once, and
+// appends the pairs whose similarity is at least min_weight to edges[lane].
+// edges is resized to InterleavedPixelBlock::kLanes if needed. The edges of
+// each pixel are the same, and in the same order, as those produced by
+// AppendCosineSimilarityEdges() for that pixel.
+void AppendBlockCosineSimilarityEdges(const InterleavedPixelBlock &block,
+		int start_time, int end_time, float min_weight,
+		BlockSimilarityWorkspace &workspace,
+		std::vector<std::vector<WeightedEdge>> &edges);
+
+} /* namespace utils */
+
+} /* namespace remote_sensing */
+
+#endif /* SIMPLEGRAPH_PHENONET_PIXELBLOCK_H_ */
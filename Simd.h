@@ -0,0 +1,76 @@
+/*
+ * Simd.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_PHENONET_SIMD_H_
+#define SIMPLEGRAPH_PHENONET_SIMD_H_
+
+// Thin wrappers over the float vector intrinsics used by the similarity
+// kernels. SIMD_ENABLED is defined when the compiler targets AVX-512 or AVX2
+// (e.g. with -march=native). Only include this header in source files.
+
+#include <cstddef>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_ENABLED 1
+#endif
+
+namespace remote_sensing {
+namespace simd {
+
+#if defined(__AVX512F__)
+typedef __m512 VectorF;
+constexpr std::size_t kLanes = 16;
+inline VectorF Zero() {
+	return _mm512_setzero_ps();
+}
+inline VectorF Broadcast(float value) {
+	return _mm512_set1_ps(value);
+}
+inline VectorF Load(const float *src) {
+	return _mm512_loadu_ps(src);
+}
+inline void Store(float *dst, VectorF value) {
+	_mm512_storeu_ps(dst, value);
+}
+// Not fused on purpose, so that the results are rounded like the scalar code.
+inline VectorF MultiplyAdd(VectorF acc, VectorF a, VectorF b) {
+	return _mm512_add_ps(acc, _mm512_mul_ps(a, b));
+}
+inline VectorF Divide(VectorF a, VectorF b) {
+	return _mm512_div_ps(a, b);
+}
+#elif defined(__AVX2__)
+typedef __m256 VectorF;
+constexpr std::size_t kLanes = 8;
+inline VectorF Zero() {
+	return _mm256_setzero_ps();
+}
+inline VectorF Broadcast(float value) {
+	return _mm256_set1_ps(value);
+}
+inline VectorF Load(const float *src) {
+	return _mm256_loadu_ps(src);
+}
+inline void Store(float *dst, VectorF value) {
+	_mm256_storeu_ps(dst, value);
+}
+// Not fused on purpose, so that the results are rounded like the scalar code.
+inline VectorF MultiplyAdd(VectorF acc, VectorF a, VectorF b) {
+	return _mm256_add_ps(acc, _mm256_mul_ps(a, b));
+}
+inline VectorF Divide(VectorF a, VectorF b) {
+	return _mm256_div_ps(a, b);
+}
+#else
+// Without SIMD this is only used to pad buffers.
+constexpr std::size_t kLanes = 8;
+#endif
+
+} /* namespace simd */
+} /* namespace remote_sensing */
+
+#endif /* SIMPLEGRAPH_PHENONET_SIMD_H_ */
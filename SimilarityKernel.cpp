@@ -0,0 +1,529 @@
+/*
+ * SimilarityKernel.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "SimilarityKernel.h"
+
+#include "Simd.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace remote_sensing {
+namespace utils {
+
+namespace {
+
+// The number of rows of the upper triangle computed together. Each loaded
+// column vector is reused for all rows in the block.
+constexpr int kRowBlock = 4;
+
+// The margin added to the upper bound of the similarity of the slices of a
+// cell of the k-d tree, which covers the rounding errors of the normalized
+// values and of the float weights (about 1e-6).
+constexpr double kNeighborBoundMargin = 1e-5;
+
+// The maximum number of points in a leaf of the k-d tree.
+constexpr int kIndexLeafSize = 8;
+
+// Loads the window [start_time, end_time) into the band major buffer and
+// computes the norm of each slice.
+template<std::size_t NumBands>
+void PackTimeSlices(const TimeSeries<float> &time_series, int start_time,
+		int num_slices, SimilarityWorkspace &workspace) {
+	const std::size_t num_bands = GetNumBands<NumBands>(
+			time_series.GetTimeSliceDimension());
+	const std::size_t stride = (num_slices + simd::kLanes - 1) / simd::kLanes
+			* simd::kLanes;
+	workspace.stride = stride;
+	workspace.slices.assign(num_bands * stride, 0);
+	workspace.norms.assign(stride, 1);
+	workspace.valid.assign(stride, 0);
+	workspace.rows.resize(kRowBlock * stride);
+	for (int k = 0; k < num_slices; ++k) {
+		const TimeSlice<float> slice = time_series.GetTimeSlice(
+				start_time + k);
+		float sum = 0;
+		for (std::size_t b = 0; b < num_bands; ++b) {
+			workspace.slices[b * stride + k] = slice[b];
+			sum += slice[b] * slice[b];
+		}
+		if (sum > EPSILON) {
+			workspace.valid[k] = 1;
+			workspace.norms[k] = std::sqrt(sum);
+		}
+	}
+}
+
+// Computes the similarities between rows[r] and all columns in
+// [column_begin, stride), r < kRowBlock, into workspace.rows[r * stride + j].
+// column_begin must be a multiple of kLanes.
+template<std::size_t NumBands>
+void ComputeRowBlock(std::size_t runtime_num_bands, const std::size_t *rows,
+		std::size_t column_begin, SimilarityWorkspace &workspace) {
+	const std::size_t num_bands = GetNumBands<NumBands>(runtime_num_bands);
+	const std::size_t stride = workspace.stride;
+	const float *slices = workspace.slices.data();
+	const float *norms = workspace.norms.data();
+	float *out = workspace.rows.data();
+#ifdef SIMD_ENABLED
+	for (std::size_t j = column_begin; j < stride; j += simd::kLanes) {
+		simd::VectorF acc[kRowBlock];
+		for (int r = 0; r < kRowBlock; ++r) {
+			acc[r] = simd::Zero();
+		}
+		for (std::size_t b = 0; b < num_bands; ++b) {
+			const float *band = slices + b * stride;
+			const simd::VectorF column = simd::Load(band + j);
+			for (int r = 0; r < kRowBlock; ++r) {
+				acc[r] = simd::MultiplyAdd(acc[r], simd::Broadcast(band[rows[r]]),
+						column);
+			}
+		}
+		const simd::VectorF column_norms = simd::Load(norms + j);
+		for (int r = 0; r < kRowBlock; ++r) {
+			simd::Store(out + r * stride + j,
+					simd::Divide(
+							simd::Divide(acc[r], simd::Broadcast(norms[rows[r]])),
+							column_norms));
+		}
+	}
+#else
+	// Accumulates one band at a time over contiguous columns, which keeps the
+	// same summation order per pair and lets the compiler vectorize over j.
+	for (int r = 0; r < kRowBlock; ++r) {
+		float *row = out + r * stride;
+		std::fill(row + column_begin, row + stride, 0.0f);
+		for (std::size_t b = 0; b < num_bands; ++b) {
+			const float *band = slices + b * stride;
+			const float value = band[rows[r]];
+			for (std::size_t j = column_begin; j < stride; ++j) {
+				row[j] += value * band[j];
+			}
+		}
+		const float row_norm = norms[rows[r]];
+		for (std::size_t j = column_begin; j < stride; ++j) {
+			row[j] = row[j] / row_norm / norms[j];
+		}
+	}
+#endif
+}
+
+// Returns the weight of the edge between the slices i < j of the packed
+// window, with the same operations as ComputeRowBlock().
+template<std::size_t NumBands>
+inline float ComputePairWeight(std::size_t runtime_num_bands, std::size_t i,
+		std::size_t j, const SimilarityWorkspace &workspace) {
+	if (!workspace.valid[i] || !workspace.valid[j]) {
+		return 0.0f;
+	}
+	const std::size_t num_bands = GetNumBands<NumBands>(runtime_num_bands);
+	const std::size_t stride = workspace.stride;
+	const float *slices = workspace.slices.data();
+	float dot = 0;
+	for (std::size_t b = 0; b < num_bands; ++b) {
+		dot += slices[b * stride + i] * slices[b * stride + j];
+	}
+	return dot / workspace.norms[i] / workspace.norms[j];
+}
+
+// Builds the subtree of the points [begin, end) of the k-d tree at node.
+void BuildIndexNode(std::size_t num_bands, std::size_t node, int begin,
+		int end, SimilarityWorkspace &workspace) {
+	if (end - begin <= kIndexLeafSize) {
+		return;
+	}
+	const float *points = workspace.index_points.data();
+	int *slices = workspace.index_slices.data();
+	std::size_t split_dimension = 0;
+	float max_spread = -1;
+	for (std::size_t b = 0; b < num_bands; ++b) {
+		float min_value = points[slices[begin] * num_bands + b];
+		float max_value = min_value;
+		for (int p = begin + 1; p < end; ++p) {
+			const float value = points[slices[p] * num_bands + b];
+			min_value = std::min(min_value, value);
+			max_value = std::max(max_value, value);
+		}
+		if (max_value - min_value > max_spread) {
+			max_spread = max_value - min_value;
+			split_dimension = b;
+		}
+	}
+	const int middle = begin + (end - begin) / 2;
+	std::nth_element(slices + begin, slices + middle, slices + end,
+			[points, num_bands, split_dimension](int slice1, int slice2) {
+				return points[slice1 * num_bands + split_dimension]
+						< points[slice2 * num_bands + split_dimension];
+			});
+	if (node >= workspace.index_split_dimensions.size()) {
+		workspace.index_split_dimensions.resize(node + 1);
+		workspace.index_split_values.resize(node + 1);
+	}
+	workspace.index_split_dimensions[node] = split_dimension;
+	workspace.index_split_values[node] = points[slices[middle] * num_bands
+			+ split_dimension];
+	// The points before middle are at most the split value, the others at
+	// least.
+	BuildIndexNode(num_bands, 2 * node + 1, begin, middle, workspace);
+	BuildIndexNode(num_bands, 2 * node + 2, middle, end, workspace);
+}
+
+// AppendCosineSimilarityEdges() for NumBands bands (any number if 0).
+template<std::size_t NumBands>
+struct CosineSimilarityKernel {
+	static void Run(const TimeSeries<float> &time_series, int start_time,
+			int end_time, float min_weight, SimilarityWorkspace &workspace,
+			std::vector<WeightedEdge> &edges);
+};
+
+// AppendNearestCosineSimilarityEdges() for NumBands bands. complete receives
+// the return value.
+template<std::size_t NumBands>
+struct NearestCosineSimilaritySearch {
+	static void Run(std::size_t runtime_num_bands, int time_slice,
+			float min_weight, std::size_t k, SimilarityWorkspace &workspace,
+			std::vector<WeightedEdge> &edges, bool &complete);
+
+	// Searches the subtree of the points [begin, end) at node, whose cell is
+	// at a squared distance of at least distance from the time slice.
+	static void SearchNode(std::size_t runtime_num_bands, std::size_t node,
+			int begin, int end, float distance, int time_slice,
+			float min_weight, std::size_t k, SimilarityWorkspace &workspace,
+			bool &complete);
+};
+
+// The same for quantized time series.
+template<std::size_t NumBands>
+struct QuantizedCosineSimilarityKernel {
+	template<typename T>
+	static void Run(const TimeSeries<T> &time_series,
+			const BandQuantization &quantization, int start_time,
+			int end_time, float min_weight, SimilarityWorkspace &workspace,
+			std::vector<WeightedEdge> &edges);
+};
+
+template<std::size_t NumBands>
+void CosineSimilarityKernel<NumBands>::Run(
+		const TimeSeries<float> &time_series, int start_time, int end_time,
+		float min_weight, SimilarityWorkspace &workspace,
+		std::vector<WeightedEdge> &edges) {
+	start_time = std::max(start_time, 0);
+	end_time = std::min(end_time,
+			static_cast<int>(time_series.GetNumTimeSlices()));
+	if (end_time - start_time < 2) {
+		return;
+	}
+	const int num_slices = end_time - start_time;
+	const std::size_t num_bands = GetNumBands<NumBands>(
+			time_series.GetTimeSliceDimension());
+	PackTimeSlices<NumBands>(time_series, start_time, num_slices, workspace);
+
+	const std::size_t stride = workspace.stride;
+	for (int block = 0; block < num_slices - 1; block += kRowBlock) {
+		// Rows past the end of the window repeat the last row and are
+		// discarded.
+		std::size_t rows[kRowBlock];
+		for (int r = 0; r < kRowBlock; ++r) {
+			rows[r] = std::min(block + r, num_slices - 1);
+		}
+		const std::size_t column_begin = (block + 1) / simd::kLanes
+				* simd::kLanes;
+		ComputeRowBlock<NumBands>(num_bands, rows, column_begin, workspace);
+
+		for (int r = 0; r < kRowBlock && block + r < num_slices - 1; ++r) {
+			const int i = block + r;
+			const bool valid_row = workspace.valid[i];
+			const float *row = workspace.rows.data() + r * stride;
+			for (int j = i + 1; j < num_slices; ++j) {
+				const float weight =
+						valid_row && workspace.valid[j] ? row[j] : 0.0f;
+				if (weight >= min_weight) {
+					edges.push_back( { { start_time + i, start_time + j },
+							weight });
+				}
+			}
+		}
+	}
+}
+
+template<std::size_t NumBands>
+void NearestCosineSimilaritySearch<NumBands>::Run(
+		std::size_t runtime_num_bands, int time_slice, float min_weight,
+		std::size_t k, SimilarityWorkspace &workspace,
+		std::vector<WeightedEdge> &edges, bool &complete) {
+	complete = true;
+	const int num_slices = workspace.valid.size();
+	time_slice -= workspace.index_start_time;
+	if (time_slice < 0 || time_slice >= num_slices
+			|| !workspace.valid[time_slice] || k == 0) {
+		return;
+	}
+	workspace.nearest.clear();
+	workspace.index_offsets.assign(runtime_num_bands, 0);
+	SearchNode(runtime_num_bands, 0, 0, workspace.index_slices.size(), 0,
+			time_slice, min_weight, k, workspace, complete);
+	std::sort_heap(workspace.nearest.begin(), workspace.nearest.end(),
+			IsHeavierEdge);
+	edges.insert(edges.end(), workspace.nearest.begin(),
+			workspace.nearest.end());
+}
+
+template<std::size_t NumBands>
+void NearestCosineSimilaritySearch<NumBands>::SearchNode(
+		std::size_t runtime_num_bands, std::size_t node, int begin, int end,
+		float distance, int time_slice, float min_weight, std::size_t k,
+		SimilarityWorkspace &workspace, bool &complete) {
+	std::vector<WeightedEdge> &nearest = workspace.nearest;
+	if (end - begin <= kIndexLeafSize) {
+		for (int p = begin; p < end; ++p) {
+			const int slice = workspace.index_slices[p];
+			if (slice == time_slice) {
+				continue;
+			}
+			const int first = std::min(time_slice, slice);
+			const int second = std::max(time_slice, slice);
+			const WeightedEdge edge = { { workspace.index_start_time + first,
+					workspace.index_start_time + second },
+					ComputePairWeight<NumBands>(runtime_num_bands, first,
+							second, workspace) };
+			if (edge.second < min_weight) {
+				continue;
+			}
+			// The lightest of the nearest neighbors is at the front.
+			if (nearest.size() < k) {
+				nearest.push_back(edge);
+				std::push_heap(nearest.begin(), nearest.end(), IsHeavierEdge);
+			} else {
+				complete = false;
+				if (IsHeavierEdge(edge, nearest.front())) {
+					std::pop_heap(nearest.begin(), nearest.end(),
+							IsHeavierEdge);
+					nearest.back() = edge;
+					std::push_heap(nearest.begin(), nearest.end(),
+							IsHeavierEdge);
+				}
+			}
+		}
+		return;
+	}
+	const std::size_t num_bands = GetNumBands<NumBands>(runtime_num_bands);
+	const std::size_t dimension = workspace.index_split_dimensions[node];
+	const float offset = workspace.index_points[time_slice * num_bands
+			+ dimension] - workspace.index_split_values[node];
+	const int middle = begin + (end - begin) / 2;
+	// Visits the child on the side of the time slice first, which usually
+	// fills the nearest neighbors before the other one is considered.
+	if (offset < 0) {
+		SearchNode(runtime_num_bands, 2 * node + 1, begin, middle, distance,
+				time_slice, min_weight, k, workspace, complete);
+	} else {
+		SearchNode(runtime_num_bands, 2 * node + 2, middle, end, distance,
+				time_slice, min_weight, k, workspace, complete);
+	}
+	float &cell_offset = workspace.index_offsets[dimension];
+	const float previous_offset = cell_offset;
+	const float far_distance = distance - previous_offset * previous_offset
+			+ offset * offset;
+	const double max_weight = 1 - far_distance / 2.0 + kNeighborBoundMargin;
+	if (max_weight < min_weight) {
+		return;
+	}
+	if (nearest.size() == k && max_weight < nearest.front().second) {
+		complete = false;
+		return;
+	}
+	cell_offset = offset;
+	if (offset < 0) {
+		SearchNode(runtime_num_bands, 2 * node + 2, middle, end, far_distance,
+				time_slice, min_weight, k, workspace, complete);
+	} else {
+		SearchNode(runtime_num_bands, 2 * node + 1, begin, middle,
+				far_distance, time_slice, min_weight, k, workspace, complete);
+	}
+	cell_offset = previous_offset;
+}
+
+template<std::size_t NumBands>
+template<typename T>
+void QuantizedCosineSimilarityKernel<NumBands>::Run(
+		const TimeSeries<T> &time_series, const BandQuantization &quantization,
+		int start_time, int end_time, float min_weight,
+		SimilarityWorkspace &workspace, std::vector<WeightedEdge> &edges) {
+	start_time = std::max(start_time, 0);
+	end_time = std::min(end_time,
+			static_cast<int>(time_series.GetNumTimeSlices()));
+	const std::size_t num_bands = GetNumBands<NumBands>(
+			time_series.GetTimeSliceDimension());
+	if (end_time - start_time < 2 || quantization.scales.size() != num_bands
+			|| quantization.offsets.size() != num_bands) {
+		return;
+	}
+	const std::size_t num_slices = end_time - start_time;
+	const bool proportional = quantization.IsProportional();
+
+	// With value = stored * s + o per band, the dot product of two slices is
+	// sum(s^2 * stored_i * stored_j) + linear_i + linear_j + sum(o^2), where
+	// linear = sum(s * o * stored).
+	workspace.band_terms.resize(2 * num_bands);
+	double *squared_scales = workspace.band_terms.data();
+	double *scaled_offsets = squared_scales + num_bands;
+	double squared_offsets = 0;
+	for (std::size_t b = 0; b < num_bands; ++b) {
+		const double scale = quantization.scales[b];
+		const double offset = quantization.offsets[b];
+		squared_scales[b] = scale * scale;
+		scaled_offsets[b] = scale * offset;
+		squared_offsets += offset * offset;
+	}
+
+	workspace.quantized_slices.resize(num_bands * num_slices);
+	workspace.quantized_norms.assign(num_slices, 0);
+	workspace.linear_terms.assign(num_slices, 0);
+	workspace.valid.assign(num_slices, 0);
+	std::int32_t *slices = workspace.quantized_slices.data();
+	for (std::size_t k = 0; k < num_slices; ++k) {
+		const TimeSlice<T> slice = time_series.GetTimeSlice(start_time + k);
+		std::int64_t sum = 0;
+		double weighted_sum = 0, linear = 0;
+		for (std::size_t b = 0; b < num_bands; ++b) {
+			const std::int32_t value = slice[b];
+			slices[b * num_slices + k] = value;
+			sum += static_cast<std::int64_t>(value) * value;
+			weighted_sum += squared_scales[b]
+					* static_cast<double>(static_cast<std::int64_t>(value)
+							* value);
+			linear += scaled_offsets[b] * value;
+		}
+		const double squared_norm =
+				proportional ? squared_scales[0] * sum
+						: weighted_sum + 2 * linear + squared_offsets;
+		// The same validity as SimilarityCosine() on the decoded values.
+		if (squared_norm > EPSILON) {
+			workspace.valid[k] = 1;
+			workspace.quantized_norms[k] =
+					proportional ? std::sqrt(static_cast<double>(sum))
+							: std::sqrt(squared_norm);
+		}
+		workspace.linear_terms[k] = linear;
+	}
+
+	// Accumulates one band at a time over contiguous columns so that the
+	// compiler can vectorize the widening multiply-adds over j.
+	workspace.integer_row.resize(num_slices);
+	workspace.quantized_row.resize(num_slices);
+	std::int64_t *integer_row = workspace.integer_row.data();
+	double *row = workspace.quantized_row.data();
+	const double *norms = workspace.quantized_norms.data();
+	for (std::size_t i = 0; i + 1 < num_slices; ++i) {
+		if (proportional) {
+			std::fill(integer_row + i + 1, integer_row + num_slices, 0);
+			for (std::size_t b = 0; b < num_bands; ++b) {
+				const std::int32_t *band = slices + b * num_slices;
+				const std::int64_t value = band[i];
+				for (std::size_t j = i + 1; j < num_slices; ++j) {
+					integer_row[j] += value * band[j];
+				}
+			}
+			for (std::size_t j = i + 1; j < num_slices; ++j) {
+				row[j] = static_cast<double>(integer_row[j]);
+			}
+		} else {
+			const double linear_i = workspace.linear_terms[i] + squared_offsets;
+			for (std::size_t j = i + 1; j < num_slices; ++j) {
+				row[j] = linear_i + workspace.linear_terms[j];
+			}
+			for (std::size_t b = 0; b < num_bands; ++b) {
+				const std::int32_t *band = slices + b * num_slices;
+				const double value = squared_scales[b] * band[i];
+				for (std::size_t j = i + 1; j < num_slices; ++j) {
+					row[j] += value * band[j];
+				}
+			}
+		}
+		const bool valid_row = workspace.valid[i];
+		for (std::size_t j = i + 1; j < num_slices; ++j) {
+			const float weight =
+					valid_row && workspace.valid[j] ?
+							static_cast<float>(row[j] / norms[i] / norms[j]) :
+							0.0f;
+			if (weight >= min_weight) {
+				edges.push_back( { { static_cast<int>(start_time + i),
+						static_cast<int>(start_time + j) }, weight });
+			}
+		}
+	}
+}
+
+} /* namespace */
+
+void AppendCosineSimilarityEdges(const TimeSeries<float> &time_series,
+		int start_time, int end_time, float min_weight,
+		SimilarityWorkspace &workspace, std::vector<WeightedEdge> &edges) {
+	DispatchNumBands<CosineSimilarityKernel>(
+			time_series.GetTimeSliceDimension(), time_series, start_time,
+			end_time, min_weight, workspace, edges);
+}
+
+void BuildCosineSimilarityIndex(const TimeSeries<float> &time_series,
+		int start_time, int end_time, SimilarityWorkspace &workspace) {
+	start_time = std::max(start_time, 0);
+	end_time = std::max(start_time,
+			std::min(end_time,
+					static_cast<int>(time_series.GetNumTimeSlices())));
+	const int num_slices = end_time - start_time;
+	const std::size_t num_bands = time_series.GetTimeSliceDimension();
+	PackTimeSlices<0>(time_series, start_time, num_slices, workspace);
+	workspace.valid.resize(num_slices);
+	workspace.index_start_time = start_time;
+	workspace.index_points.resize(num_slices * num_bands);
+	workspace.index_slices.clear();
+	for (int k = 0; k < num_slices; ++k) {
+		if (!workspace.valid[k]) {
+			continue;
+		}
+		workspace.index_slices.push_back(k);
+		for (std::size_t b = 0; b < num_bands; ++b) {
+			workspace.index_points[k * num_bands + b] =
+					workspace.slices[b * workspace.stride + k]
+							/ workspace.norms[k];
+		}
+	}
+	BuildIndexNode(num_bands, 0, 0, workspace.index_slices.size(), workspace);
+}
+
+bool AppendNearestCosineSimilarityEdges(int time_slice, float min_weight,
+		std::size_t k, SimilarityWorkspace &workspace,
+		std::vector<WeightedEdge> &edges) {
+	const std::size_t num_bands =
+			workspace.stride > 0 ?
+					workspace.slices.size() / workspace.stride : 0;
+	bool complete = true;
+	DispatchNumBands<NearestCosineSimilaritySearch>(num_bands, num_bands,
+			time_slice, min_weight, k, workspace, edges, complete);
+	return complete;
+}
+
+void AppendCosineSimilarityEdges(const TimeSeries<std::int16_t> &time_series,
+		const BandQuantization &quantization, int start_time, int end_time,
+		float min_weight, SimilarityWorkspace &workspace,
+		std::vector<WeightedEdge> &edges) {
+	DispatchNumBands<QuantizedCosineSimilarityKernel>(
+			time_series.GetTimeSliceDimension(), time_series, quantization,
+			start_time, end_time, min_weight, workspace, edges);
+}
+
+void AppendCosineSimilarityEdges(const TimeSeries<std::uint16_t> &time_series,
+		const BandQuantization &quantization, int start_time, int end_time,
+		float min_weight, SimilarityWorkspace &workspace,
+		std::vector<WeightedEdge> &edges) {
+	DispatchNumBands<QuantizedCosineSimilarityKernel>(
+			time_series.GetTimeSliceDimension(), time_series, quantization,
+			start_time, end_time, min_weight, workspace, edges);
+}
+
+} /* namespace utils */
+} /* namespace remote_sensing */
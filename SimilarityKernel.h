@@ -0,0 +1,134 @@
+/*
+ * SimilarityKernel.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_PHENONET_SIMILARITYKERNEL_H_
+#define SIMPLEGRAPH_PHENONET_SIMILARITYKERNEL_H_
+
+#include "TimeSeries.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace remote_sensing {
+namespace utils {
+
+// An undirected edge between two time slices, stored as
+// <<node_1, node_2>, weight>.
+typedef std::pair<std::pair<int, int>, float> WeightedEdge;
+
+// Orders edges by their weights in descending order. Ties are broken by the
+// node ids so that the order does not depend on the sorting algorithm.
+inline bool IsHeavierEdge(const WeightedEdge &edge1,
+		const WeightedEdge &edge2) {
+	if (edge1.second != edge2.second) {
+		return edge1.second > edge2.second;
+	}
+	return edge1.first < edge2.first;
+}
+
+// Buffers used by the similarity kernels. They are meant to be kept (e.g. one
+// per thread) and reused from pixel to pixel to avoid reallocations.
+struct SimilarityWorkspace {
+	// The time slices in band major order, i.e. band b of the k-th slice in
+	// the window is stored at slices[b * stride + k]. stride is padded to a
+	// multiple of the SIMD width with zeros.
+	std::vector<float> slices;
+	// The L2 norm of each time slice (padded with 1).
+	std::vector<float> norms;
+	// Whether the squared norm of each slice is above EPSILON. Invalid slices
+	// have a similarity of 0 with any other slice (see SimilarityCosine).
+	std::vector<char> valid;
+	// The similarities of a block of rows of the upper triangle.
+	std::vector<float> rows;
+	std::size_t stride = 0;
+	// The buffers of the quantized kernels: the stored values widened to 32
+	// bits, band b of the k-th slice at quantized_slices[b * num_slices + k],
+	// the norm and the offset term of each slice, the scale terms of each
+	// band and the dot products of one row.
+	std::vector<std::int32_t> quantized_slices;
+	std::vector<double> quantized_norms;
+	std::vector<double> linear_terms;
+	std::vector<double> band_terms;
+	std::vector<std::int64_t> integer_row;
+	std::vector<double> quantized_row;
+	// The k-d tree of the nearest neighbor search (see
+	// BuildCosineSimilarityIndex()): the normalized values of the valid
+	// slices of the window in the order of the tree, point by point, the
+	// slice of each point, the splitting dimension and value of each node of
+	// the tree (stored like a binary heap), the offsets of a query to the
+	// cell of the current node and the nearest neighbors of one slice (a
+	// heap).
+	std::vector<float> index_points;
+	std::vector<int> index_slices;
+	std::vector<int> index_split_dimensions;
+	std::vector<float> index_split_values;
+	std::vector<float> index_offsets;
+	std::vector<WeightedEdge> nearest;
+	int index_start_time = 0;
+};
+
+// Computes the cosine similarity of all pairs of time slices (i, j),
+// start_time <= i < j < end_time, and appends the pairs whose similarity is at
+// least min_weight to edges, in the same order as a nested loop over i and j.
+//
+// Every slice is normalized once, then the upper triangle is computed as
+// blocks of dot products vectorized over j (AVX-512 or AVX2 when the compiler
+// targets them, e.g. with -march=native, and a scalar loop otherwise).
+// The bands are accumulated and the norms divided in the same order as
+// SimilarityCosine(), so the weights are bit-identical to SimilarityCosine()
+// unless the compiler contracts multiply-adds into FMAs, which is disabled by
+// default with -std=c++0x. With -ffp-contract=fast or -ffast-math the weights
+// are within a relative error of 1e-6.
+void AppendCosineSimilarityEdges(const TimeSeries<float> &time_series,
+		int start_time, int end_time, float min_weight,
+		SimilarityWorkspace &workspace, std::vector<WeightedEdge> &edges);
+
+// Builds an index of the time slices [start_time, end_time) for
+// AppendNearestCosineSimilarityEdges(). The slices are normalized and stored
+// in a k-d tree, which is split at the median of the dimension with the
+// largest spread.
+void BuildCosineSimilarityIndex(const TimeSeries<float> &time_series,
+		int start_time, int end_time, SimilarityWorkspace &workspace);
+
+// Appends the k heaviest (see IsHeavierEdge()) of the edges of a time slice
+// of the indexed window that AppendCosineSimilarityEdges() would compute,
+// heaviest first, with bit-identical weights. Only the cells of the k-d tree
+// that may hold one of them are visited: the cosine similarity of two unit
+// vectors a and b is 1 - |a - b|^2 / 2, so a cell is skipped if its distance
+// to the time slice bounds the similarity of its slices below min_weight or
+// below the k-th edge found so far. Returns true if these are all the edges
+// of the time slice, i.e. fewer than k were found or no others remain.
+// min_weight must be positive, since the slices whose norm is too small to
+// be normalized (see SimilarityCosine()) are not indexed.
+bool AppendNearestCosineSimilarityEdges(int time_slice, float min_weight,
+		std::size_t k, SimilarityWorkspace &workspace,
+		std::vector<WeightedEdge> &edges);
+
+// The same for quantized time series, computed on the stored integers
+// without decoding them. With a proportional quantization (see
+// BandQuantization::IsProportional()) the products are widened to 64 bits
+// and accumulated exactly, since the scale cancels out of the cosine.
+// Otherwise each product is weighted by the squared scale of its band in
+// double precision, and the offsets are folded in with one term per time
+// slice. Either way the weights are rounded from a more accurate dot product
+// than in the float kernel, so they may differ from those of the decoded
+// values in the last bits. No edges are added if the quantization does not
+// have one scale and offset per band.
+void AppendCosineSimilarityEdges(const TimeSeries<std::int16_t> &time_series,
+		const BandQuantization &quantization, int start_time, int end_time,
+		float min_weight, SimilarityWorkspace &workspace,
+		std::vector<WeightedEdge> &edges);
+void AppendCosineSimilarityEdges(const TimeSeries<std::uint16_t> &time_series,
+		const BandQuantization &quantization, int start_time, int end_time,
+		float min_weight, SimilarityWorkspace &workspace,
+		std::vector<WeightedEdge> &edges);
+
+} /* namespace utils */
+} /* namespace remote_sensing */
+
+#endif /* SIMPLEGRAPH_PHENONET_SIMILARITYKERNEL_H_ */
@@ -0,0 +1,118 @@
+/*
+ * SpaceTimeDecomposition.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "SpaceTimeDecomposition.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace remote_sensing {
+
+namespace {
+
+// Returns the first item of a block when num_items items are divided into
+// num_blocks contiguous blocks of (almost) equal sizes.
+inline int GetBlockBegin(int block, int num_items, int num_blocks) {
+	return static_cast<long long>(block) * num_items / num_blocks;
+}
+
+// Returns the block of an item (see GetBlockBegin()).
+int GetBlock(int item, int num_items, int num_blocks) {
+	int block = static_cast<long long>(item) * num_blocks / num_items;
+	while (block + 1 < num_blocks
+			&& GetBlockBegin(block + 1, num_items, num_blocks) <= item) {
+		++block;
+	}
+	while (block > 0 && GetBlockBegin(block, num_items, num_blocks) > item) {
+		--block;
+	}
+	return block;
+}
+
+} /* namespace */
+
+SpaceTimeDecomposition::SpaceTimeDecomposition(int num_pixels,
+		int num_time_slices, int num_tiles, int num_tasks_per_node) :
+		num_pixels_(num_pixels), num_time_slices_(num_time_slices), num_tiles_(
+				num_tiles), num_tasks_per_node_(num_tasks_per_node), group_communicator_(
+				MPI_COMM_NULL), num_groups_(0), group_(-1), group_rank_(-1) {
+}
+
+SpaceTimeDecomposition::~SpaceTimeDecomposition() {
+	FreeGroupCommunicator();
+}
+
+bool SpaceTimeDecomposition::Plan(MPI_Comm communicator, int num_groups) {
+	FreeGroupCommunicator();
+	tiles_.clear();
+	int size, rank;
+	MPI_Comm_size(communicator, &size);
+	MPI_Comm_rank(communicator, &rank);
+	if (num_pixels_ <= 0 || num_time_slices_ <= 0 || num_tiles_ <= 0
+			|| num_tiles_ > num_pixels_ || num_tasks_per_node_ <= 0
+			|| num_groups <= 0) {
+		if (rank == 0) {
+			std::cerr << "Invalid decomposition: " << num_pixels_
+					<< " pixels, " << num_time_slices_ << " time slices, "
+					<< num_tiles_ << " tiles, " << num_tasks_per_node_
+					<< " tasks per node, " << num_groups << " groups\n";
+		}
+		return false;
+	}
+
+	// Level 1: whole nodes form the groups, each with a block of tiles.
+	const int num_nodes = (size + num_tasks_per_node_ - 1) / num_tasks_per_node_;
+	num_groups_ = std::min(num_groups, std::min(num_nodes, num_tiles_));
+	const int node = rank / num_tasks_per_node_;
+	group_ = GetBlock(node, num_nodes, num_groups_);
+	if (MPI_Comm_split(communicator, group_, rank, &group_communicator_)
+			!= MPI_SUCCESS) {
+		group_communicator_ = MPI_COMM_NULL;
+		return false;
+	}
+	int group_size;
+	MPI_Comm_size(group_communicator_, &group_size);
+	MPI_Comm_rank(group_communicator_, &group_rank_);
+	const int num_group_nodes = GetBlockBegin(group_ + 1, num_nodes,
+			num_groups_) - GetBlockBegin(group_, num_nodes, num_groups_);
+
+	// Level 2: the nodes of the group read the time slices of a tile in
+	// turns (starting from a different node for each tile), and every task
+	// gets a sub-tile.
+	const int first_tile = GetBlockBegin(group_, num_tiles_, num_groups_);
+	const int last_tile = GetBlockBegin(group_ + 1, num_tiles_, num_groups_);
+	for (int t = first_tile; t < last_tile; ++t) {
+		const int first_pixel = GetBlockBegin(t, num_pixels_, num_tiles_);
+		Tile tile = { first_pixel, GetBlockBegin(t + 1, num_pixels_,
+				num_tiles_) - first_pixel, std::vector<int>(num_time_slices_),
+				utils::DecompositionSchema(group_size, 0) };
+		for (int i = 0; i < num_time_slices_; ++i) {
+			// The first task of each node reads.
+			tile.time_slice_index_to_task[i] = (i + t) % num_group_nodes
+					* num_tasks_per_node_;
+		}
+		tile.schema.counts.resize(group_size);
+		tile.schema.displacements.resize(group_size);
+		for (int task = 0; task < group_size; ++task) {
+			tile.schema.displacements[task] = GetBlockBegin(task,
+					tile.num_pixels, group_size);
+			tile.schema.counts[task] = GetBlockBegin(task + 1,
+					tile.num_pixels, group_size)
+					- tile.schema.displacements[task];
+		}
+		tiles_.push_back(std::move(tile));
+	}
+	return true;
+}
+
+void SpaceTimeDecomposition::FreeGroupCommunicator() {
+	if (group_communicator_ != MPI_COMM_NULL) {
+		MPI_Comm_free(&group_communicator_);
+		group_communicator_ = MPI_COMM_NULL;
+	}
+}
+
+} /* namespace remote_sensing */
@@ -0,0 +1,101 @@
+/*
+ * SpaceTimeDecomposition.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_PHENONET_SPACETIMEDECOMPOSITION_H_
+#define SIMPLEGRAPH_PHENONET_SPACETIMEDECOMPOSITION_H_
+
+#include "Utils.h"
+
+#include <mpi.h>
+#include <vector>
+
+namespace remote_sensing {
+
+/*
+ * Plans the two-level Space-and-Time decomposition of the system-wide data
+ * distribution model:
+ * 1) Space: the image (num_pixels pixels) is divided into num_tiles tiles of
+ *    contiguous pixels. The computing nodes are divided into node groups of
+ *    whole nodes, each with its own communicator, and each group is
+ *    responsible for a contiguous block of tiles, i.e. a spatial extent,
+ *    over all dates. The tiles of a group are processed one after another.
+ * 2) Space and time within a group: the time slices (dates) of a tile are
+ *    read by the nodes of the group in turns (by the first task of each
+ *    node), and the tile is divided into sub-tiles, one per task of the
+ *    group.
+ * The plan of each tile is given as the inputs of TimeSeriesDecomposition
+ * on the group communicator, so data is only exchanged within groups.
+ *
+ * The tasks are assumed to be placed node by node, i.e. tasks
+ * [k * num_tasks_per_node, (k + 1) * num_tasks_per_node) run on node k.
+ */
+class SpaceTimeDecomposition {
+public:
+	// The plan of one tile within a node group.
+	struct Tile {
+		// The tile covers the pixels [first_pixel, first_pixel + num_pixels)
+		// of the image.
+		int first_pixel;
+		int num_pixels;
+		// The task (rank in the group communicator) that reads each time
+		// slice of the tile.
+		std::vector<int> time_slice_index_to_task;
+		// The sub-tiles of the tasks of the group, relative to first_pixel.
+		utils::DecompositionSchema schema;
+	};
+
+	SpaceTimeDecomposition(int num_pixels, int num_time_slices, int num_tiles,
+			int num_tasks_per_node);
+
+	virtual ~SpaceTimeDecomposition();
+	SpaceTimeDecomposition(const SpaceTimeDecomposition &other) = delete;
+	SpaceTimeDecomposition& operator=(const SpaceTimeDecomposition &other) = delete;
+
+	// Splits the tasks of communicator into (at most) num_groups node groups
+	// and plans the tiles of the group of this task. This is collective over
+	// communicator. Returns false if the parameters are invalid.
+	bool Plan(MPI_Comm communicator, int num_groups);
+
+	// The communicator of the node group of this task.
+	inline MPI_Comm GetGroupCommunicator() const {
+		return group_communicator_;
+	}
+
+	inline int GetNumGroups() const {
+		return num_groups_;
+	}
+
+	inline int GetGroup() const {
+		return group_;
+	}
+
+	// The rank of this task in the group communicator.
+	inline int GetGroupRank() const {
+		return group_rank_;
+	}
+
+	// The tiles of the group of this task, in the order they are processed.
+	inline const std::vector<Tile>& GetTiles() const {
+		return tiles_;
+	}
+
+private:
+	const int num_pixels_;
+	const int num_time_slices_;
+	const int num_tiles_;
+	const int num_tasks_per_node_;
+	MPI_Comm group_communicator_;
+	int num_groups_;
+	int group_;
+	int group_rank_;
+	std::vector<Tile> tiles_;
+
+	void FreeGroupCommunicator();
+};
+
+} /* namespace remote_sensing */
+
+#endif /* SIMPLEGRAPH_PHENONET_SPACETIMEDECOMPOSITION_H_ */
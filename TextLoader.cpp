@@ -0,0 +1,272 @@
+/*
+ * TextLoader.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "TextLoader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace remote_sensing {
+
+namespace {
+
+// The powers of ten that are exact in a float.
+const float kPowersOfTen[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f,
+		1e7f, 1e8f, 1e9f, 1e10f };
+constexpr int kMaxExactPowerOfTen = 10;
+constexpr std::uint64_t kMaxExactMantissa = 1 << 24;
+// The digits that fit in the 64-bit mantissa.
+constexpr int kMaxNumDigits = 19;
+
+inline bool IsDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+// Separates the values of a line.
+inline bool IsBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// Parses [begin, end) with strtof, for the numbers the fast path cannot
+// round exactly.
+const char* ParseFloatSlow(const char *begin, const char *end, float &value) {
+	const char *token_end = begin;
+	while (token_end != end && !IsBlank(*token_end) && *token_end != '\n') {
+		++token_end;
+	}
+	// strtof needs a terminated string.
+	const std::string token(begin, token_end);
+	char *parsed_end = nullptr;
+	const float parsed = std::strtof(token.c_str(), &parsed_end);
+	if (parsed_end == token.c_str()) {
+		return begin;
+	}
+	value = parsed;
+	return begin + (parsed_end - token.c_str());
+}
+
+// The mapping of a whole file, which is read-only.
+class MappedFile {
+public:
+	MappedFile() :
+			data_(nullptr), size_(0) {
+	}
+
+	~MappedFile() {
+		if (size_ > 0) {
+			munmap(const_cast<char*>(data_), size_);
+		}
+	}
+
+	MappedFile(const MappedFile &other) = delete;
+	MappedFile& operator=(const MappedFile &other) = delete;
+
+	bool Open(const std::string &path) {
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat file_status;
+		if (fstat(fd, &file_status) != 0) {
+			close(fd);
+			return false;
+		}
+		// An empty file cannot be mapped, and has no lines anyway.
+		if (file_status.st_size > 0) {
+			void *mapping = mmap(nullptr, file_status.st_size, PROT_READ,
+					MAP_PRIVATE, fd, 0);
+			if (mapping == MAP_FAILED) {
+				close(fd);
+				return false;
+			}
+			madvise(mapping, file_status.st_size, MADV_SEQUENTIAL);
+			data_ = static_cast<const char*>(mapping);
+			size_ = file_status.st_size;
+		}
+		close(fd);
+		return true;
+	}
+
+	inline const char* begin() const {
+		return data_;
+	}
+
+	inline const char* end() const {
+		return data_ + size_;
+	}
+
+private:
+	const char *data_;
+	std::size_t size_;
+};
+
+} /* namespace */
+
+bool TextLoader::LoadTimeSlice(const std::string &path,
+		std::size_t first_pixel, std::size_t num_pixels,
+		const std::vector<float*> &bands) {
+	MappedFile file;
+	if (!file.Open(path)) {
+		std::cerr << "Cannot open the input data. "
+				<< "Please check if the file exists: " << path << std::endl;
+		return false;
+	}
+	const char *p = file.begin();
+	const char *end = file.end();
+	for (std::size_t j = 0; j < first_pixel && p != end; ++j) {
+		const char *line_end = static_cast<const char*>(std::memchr(p, '\n',
+				end - p));
+		p = line_end != nullptr ? line_end + 1 : end;
+	}
+	for (std::size_t j = 0; j < num_pixels; ++j) {
+		if (p == end) {
+			std::cerr << path << " has fewer than " << first_pixel + num_pixels
+					<< " pixels" << std::endl;
+			return false;
+		}
+		for (std::size_t band = 0; band < bands.size(); ++band) {
+			while (p != end && IsBlank(*p)) {
+				++p;
+			}
+			const char *value_end = ParseFloat(p, end, bands[band][j]);
+			if (value_end == p) {
+				std::cerr << path << " has fewer than " << bands.size()
+						<< " values at line " << first_pixel + j + 1
+						<< std::endl;
+				return false;
+			}
+			p = value_end;
+		}
+		// Skips the rest of the line.
+		const char *line_end = static_cast<const char*>(std::memchr(p, '\n',
+				end - p));
+		p = line_end != nullptr ? line_end + 1 : end;
+	}
+	return true;
+}
+
+bool TextLoader::LoadTimeSlices(const std::vector<std::string> &paths,
+		std::size_t first_pixel, std::size_t num_pixels, int num_bands,
+		float *values, int num_threads) {
+	const int num_files = static_cast<int>(paths.size());
+	const std::size_t num_file_values = static_cast<std::size_t>(num_bands)
+			* num_pixels;
+	bool succeeded = true;
+#ifdef _OPENMP
+	if (num_threads <= 0) {
+		num_threads = omp_get_max_threads();
+	}
+	// The files take about the same time, but dynamic scheduling hides
+	// slow reads.
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads) \
+	reduction(&&: succeeded) if (num_threads > 1)
+#endif
+	for (int i = 0; i < num_files; ++i) {
+		std::vector<float*> bands(num_bands);
+		for (int band = 0; band < num_bands; ++band) {
+			bands[band] = values + i * num_file_values + band * num_pixels;
+		}
+		succeeded = LoadTimeSlice(paths[i], first_pixel, num_pixels, bands)
+				&& succeeded;
+	}
+	return succeeded;
+}
+
+const char* TextLoader::ParseFloat(const char *begin, const char *end,
+		float &value) {
+	const char *p = begin;
+	bool negative = false;
+	if (p != end && (*p == '-' || *p == '+')) {
+		negative = *p++ == '-';
+	}
+	// The value is mantissa * 10^exponent.
+	std::uint64_t mantissa = 0;
+	int exponent = 0;
+	int num_digits = 0;
+	bool has_digits = false;
+	// Whether nonzero digits were dropped, which the fast path cannot round.
+	bool truncated = false;
+	for (; p != end && IsDigit(*p); ++p) {
+		has_digits = true;
+		if (num_digits < kMaxNumDigits) {
+			mantissa = mantissa * 10 + (*p - '0');
+			num_digits += mantissa > 0;
+		} else {
+			++exponent;
+			truncated = truncated || *p != '0';
+		}
+	}
+	if (p != end && *p == '.') {
+		for (++p; p != end && IsDigit(*p); ++p) {
+			has_digits = true;
+			if (num_digits < kMaxNumDigits) {
+				mantissa = mantissa * 10 + (*p - '0');
+				num_digits += mantissa > 0;
+				--exponent;
+			} else {
+				truncated = truncated || *p != '0';
+			}
+		}
+	}
+	if (!has_digits) {
+		// E.g. inf and nan.
+		return ParseFloatSlow(begin, end, value);
+	}
+	// The exponent only belongs to the number if it has digits.
+	if (p != end && (*p == 'e' || *p == 'E')) {
+		const char *q = p + 1;
+		bool negative_exponent = false;
+		if (q != end && (*q == '-' || *q == '+')) {
+			negative_exponent = *q++ == '-';
+		}
+		if (q != end && IsDigit(*q)) {
+			int explicit_exponent = 0;
+			for (; q != end && IsDigit(*q); ++q) {
+				// Saturates, far beyond the range of float.
+				if (explicit_exponent < 100000) {
+					explicit_exponent = explicit_exponent * 10 + (*q - '0');
+				}
+			}
+			exponent += negative_exponent ? -explicit_exponent
+					: explicit_exponent;
+			p = q;
+		}
+	}
+	// Trailing zeros, e.g. 0.051200000, keep the mantissa small.
+	while (mantissa != 0 && mantissa % 10 == 0) {
+		mantissa /= 10;
+		++exponent;
+	}
+	if (mantissa == 0 && !truncated) {
+		value = negative ? -0.0f : 0.0f;
+		return p;
+	}
+	if (truncated || mantissa > kMaxExactMantissa
+			|| exponent < -kMaxExactPowerOfTen
+			|| exponent > kMaxExactPowerOfTen) {
+		return ParseFloatSlow(begin, end, value);
+	}
+	// Both operands are exact, so the single rounding of the product or
+	// quotient is the correct rounding of the number.
+	const float f = static_cast<float>(mantissa);
+	value = exponent < 0 ? f / kPowersOfTen[-exponent]
+			: f * kPowersOfTen[exponent];
+	if (negative) {
+		value = -value;
+	}
+	return p;
+}
+
+} /* namespace remote_sensing */
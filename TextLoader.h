@@ -0,0 +1,50 @@
+/*
+ * TextLoader.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_PHENONET_TEXTLOADER_H_
+#define SIMPLEGRAPH_PHENONET_TEXTLOADER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace remote_sensing {
+
+/*
+ * Loads time slices stored as text like the example data: one file per time
+ * slice (e.g. day_N.txt), with one line per pixel holding the values of its
+ * bands separated by tabs or spaces. The files are memory-mapped and parsed
+ * in place with a locale-independent number parser, and the values are
+ * written straight into band-major buffers: band b of pixel j goes to
+ * bands[b][j].
+ */
+class TextLoader {
+public:
+	// Loads the pixels [first_pixel, first_pixel + num_pixels) of one file,
+	// i.e. its lines [first_pixel, first_pixel + num_pixels), into
+	// bands[band][0 .. num_pixels). Returns false if the file cannot be
+	// read, or if it has fewer lines or a line has fewer values than needed.
+	static bool LoadTimeSlice(const std::string &path, std::size_t first_pixel,
+			std::size_t num_pixels, const std::vector<float*> &bands);
+
+	// Loads the files in parallel with num_threads threads (0 uses the
+	// OpenMP default), file i into the num_bands * num_pixels values at
+	// values + i * num_bands * num_pixels, ordered by band. Returns false if
+	// any file fails.
+	static bool LoadTimeSlices(const std::vector<std::string> &paths,
+			std::size_t first_pixel, std::size_t num_pixels, int num_bands,
+			float *values, int num_threads = 0);
+
+	// Parses a decimal number at the start of [begin, end) like strtof in
+	// the C locale, with the same rounding. Returns the end of the number,
+	// or begin if there is none.
+	static const char* ParseFloat(const char *begin, const char *end,
+			float &value);
+};
+
+} /* namespace remote_sensing */
+
+#endif /* SIMPLEGRAPH_PHENONET_TEXTLOADER_H_ */
@@ -0,0 +1,477 @@
+/*
+ * TileCube.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "TileCube.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace remote_sensing {
+
+namespace {
+
+const char kMagic[4] = { 'P', 'N', 'T', 'C' };
+constexpr std::uint32_t kVersion = 1;
+// Bounds the header of a corrupted file.
+constexpr std::uint32_t kMaxNumBands = 1 << 16;
+
+struct FileHeader {
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t num_bands;
+	std::uint32_t num_time_slices;
+	std::uint64_t num_pixels;
+	std::uint32_t data_type;
+	std::uint32_t pixels_per_chunk;
+	std::uint64_t data_offset;
+};
+
+inline std::uint64_t GetHeaderSize(int num_bands) {
+	return sizeof(FileHeader) + 2 * sizeof(float) * num_bands;
+}
+
+inline std::uint64_t GetDataOffset(int num_bands) {
+	return (GetHeaderSize(num_bands) + 63) / 64 * 64;
+}
+
+inline std::size_t GetValueSize(CubeDataType data_type) {
+	return data_type == CubeDataType::kFloat32 ? sizeof(float) : 2;
+}
+
+MPI_Datatype GetMPIDataType(CubeDataType data_type) {
+	switch (data_type) {
+	case CubeDataType::kInt16:
+		return MPI_SHORT;
+	case CubeDataType::kUInt16:
+		return MPI_UNSIGNED_SHORT;
+	default:
+		return MPI_FLOAT;
+	}
+}
+
+bool IsValid(const TileCubeInfo &info) {
+	return info.num_bands > 0 && info.num_time_slices > 0
+			&& info.num_pixels > 0 && info.pixels_per_chunk > 0
+			&& (info.data_type == CubeDataType::kFloat32
+					|| info.data_type == CubeDataType::kInt16
+					|| info.data_type == CubeDataType::kUInt16)
+			&& info.scales.size() == static_cast<std::size_t>(info.num_bands)
+			&& info.offsets.size() == static_cast<std::size_t>(info.num_bands);
+}
+
+// Stores a value as the data type of the cube.
+void EncodeValue(float value, float scale, float offset,
+		CubeDataType data_type, char *out) {
+	if (data_type == CubeDataType::kFloat32) {
+		std::memcpy(out, &value, sizeof(value));
+		return;
+	}
+	const bool is_signed = data_type == CubeDataType::kInt16;
+	const float min_value = is_signed ? -32768.0f : 0.0f;
+	const float max_value = is_signed ? 32767.0f : 65535.0f;
+	float stored = std::round((value - offset) / scale);
+	// Also maps NaN to the smallest value.
+	if (!(stored >= min_value))
+		stored = min_value;
+	if (stored > max_value)
+		stored = max_value;
+	if (is_signed) {
+		const std::int16_t quantized = static_cast<std::int16_t>(stored);
+		std::memcpy(out, &quantized, sizeof(quantized));
+	} else {
+		const std::uint16_t quantized = static_cast<std::uint16_t>(stored);
+		std::memcpy(out, &quantized, sizeof(quantized));
+	}
+}
+
+float DecodeValue(const char *in, float scale, float offset,
+		CubeDataType data_type) {
+	if (data_type == CubeDataType::kInt16) {
+		std::int16_t quantized;
+		std::memcpy(&quantized, in, sizeof(quantized));
+		return quantized * scale + offset;
+	} else if (data_type == CubeDataType::kUInt16) {
+		std::uint16_t quantized;
+		std::memcpy(&quantized, in, sizeof(quantized));
+		return quantized * scale + offset;
+	}
+	float value;
+	std::memcpy(&value, in, sizeof(value));
+	return value;
+}
+
+// Reads the header and the scales and offsets of a cube.
+bool ReadHeader(const std::string &path, std::vector<char> &bytes) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		std::cerr << "cannot open " << path << std::endl;
+		return false;
+	}
+	FileHeader header;
+	bytes.clear();
+	if (in.read(reinterpret_cast<char*>(&header), sizeof(header))
+			&& std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0
+			&& header.version == kVersion && header.num_bands > 0
+			&& header.num_bands <= kMaxNumBands) {
+		bytes.resize(GetHeaderSize(header.num_bands));
+		std::memcpy(bytes.data(), &header, sizeof(header));
+		if (in.read(bytes.data() + sizeof(header),
+				bytes.size() - sizeof(header))) {
+			return true;
+		}
+	}
+	std::cerr << "invalid tile cube: " << path << std::endl;
+	return false;
+}
+
+bool ParseHeader(const std::vector<char> &bytes, TileCubeInfo &info) {
+	if (bytes.size() < sizeof(FileHeader)) {
+		return false;
+	}
+	FileHeader header;
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	if (header.num_time_slices > INT_MAX || header.pixels_per_chunk > INT_MAX
+			|| bytes.size() != GetHeaderSize(header.num_bands)) {
+		return false;
+	}
+	info.num_bands = header.num_bands;
+	info.num_time_slices = header.num_time_slices;
+	info.num_pixels = header.num_pixels;
+	info.data_type = static_cast<CubeDataType>(header.data_type);
+	info.pixels_per_chunk = header.pixels_per_chunk;
+	info.data_offset = header.data_offset;
+	const float *scales = reinterpret_cast<const float*>(bytes.data()
+			+ sizeof(header));
+	info.scales.assign(scales, scales + info.num_bands);
+	info.offsets.assign(scales + info.num_bands, scales + 2 * info.num_bands);
+	return IsValid(info) && info.data_offset >= bytes.size();
+}
+
+// Builds the file and memory types that read the pixels [first_pixel,
+// first_pixel + num_pixels) of a cube: in the file, one subarray per
+// overlapping chunk; in memory, the values of each pixel are contiguous,
+// ordered by (time slice, band).
+void BuildReadTypes(const TileCubeInfo &info, std::uint64_t first_pixel,
+		std::uint64_t num_pixels, MPI_Datatype value_type,
+		MPI_Datatype &file_type, MPI_Datatype &memory_type) {
+	const std::uint64_t chunk_size = info.pixels_per_chunk;
+	const std::uint64_t slice_size = static_cast<std::uint64_t>(
+			info.num_time_slices) * info.num_bands;
+	const std::size_t value_size = GetValueSize(info.data_type);
+	const std::uint64_t last_pixel = first_pixel + num_pixels;
+	std::vector<MPI_Datatype> file_types, memory_types;
+	std::vector<MPI_Aint> file_displacements, memory_displacements;
+	for (std::uint64_t chunk = first_pixel / chunk_size;
+			chunk * chunk_size < last_pixel; ++chunk) {
+		const std::uint64_t chunk_first = chunk * chunk_size;
+		const int chunk_pixels = std::min(chunk_size,
+				info.num_pixels - chunk_first);
+		const std::uint64_t begin = std::max(first_pixel, chunk_first);
+		const int count = std::min(last_pixel, chunk_first + chunk_pixels)
+				- begin;
+		int sizes[3] = { info.num_time_slices, info.num_bands, chunk_pixels };
+		int subsizes[3] = { info.num_time_slices, info.num_bands, count };
+		int starts[3] = { 0, 0, static_cast<int>(begin - chunk_first) };
+		MPI_Datatype type;
+		MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C,
+				value_type, &type);
+		file_types.push_back(type);
+		file_displacements.push_back(chunk_first * slice_size * value_size);
+
+		// The pixels of a band of a time slice are slice_size values apart.
+		MPI_Datatype pixels, resized_pixels, bands;
+		MPI_Type_vector(count, 1, slice_size, value_type, &pixels);
+		MPI_Type_create_resized(pixels, 0, value_size, &resized_pixels);
+		MPI_Type_contiguous(info.num_bands, resized_pixels, &bands);
+		MPI_Type_contiguous(info.num_time_slices, bands, &type);
+		MPI_Type_free(&pixels);
+		MPI_Type_free(&resized_pixels);
+		MPI_Type_free(&bands);
+		memory_types.push_back(type);
+		memory_displacements.push_back(
+				(begin - first_pixel) * slice_size * value_size);
+	}
+	const std::vector<int> lengths(file_types.size(), 1);
+	MPI_Type_create_struct(file_types.size(), lengths.data(),
+			file_displacements.data(), file_types.data(), &file_type);
+	MPI_Type_create_struct(memory_types.size(), lengths.data(),
+			memory_displacements.data(), memory_types.data(), &memory_type);
+	MPI_Type_commit(&file_type);
+	MPI_Type_commit(&memory_type);
+	for (std::size_t i = 0; i < file_types.size(); ++i) {
+		MPI_Type_free(&file_types[i]);
+		MPI_Type_free(&memory_types[i]);
+	}
+}
+
+// Reads the header of a cube at the first task of the communicator and
+// broadcasts it. Returns false on all tasks if it is not a valid cube.
+bool ReadSharedInfo(MPI_Comm communicator, const std::string &path,
+		TileCubeInfo &info) {
+	int rank;
+	MPI_Comm_rank(communicator, &rank);
+	// Only the first task reads the header.
+	std::vector<char> bytes;
+	unsigned long long header_size = 0;
+	if (rank == 0 && ReadHeader(path, bytes)) {
+		header_size = bytes.size();
+	}
+	MPI_Bcast(&header_size, 1, MPI_UNSIGNED_LONG_LONG, 0, communicator);
+	if (header_size == 0) {
+		return false;
+	}
+	bytes.resize(header_size);
+	MPI_Bcast(bytes.data(), header_size, MPI_CHAR, 0, communicator);
+	if (!ParseHeader(bytes, info)) {
+		if (rank == 0)
+			std::cerr << "invalid tile cube: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Reads the stored values of the pixels [first_pixel, first_pixel +
+// num_pixels) of a cube, pixel by pixel and ordered by (time slice, band)
+// within a pixel, with one collective read.
+bool ReadPixelValues(MPI_Comm communicator, const std::string &path,
+		const TileCubeInfo &info, std::uint64_t first_pixel,
+		std::uint64_t num_pixels, std::vector<char> &values) {
+	int rank;
+	MPI_Comm_rank(communicator, &rank);
+	const std::uint64_t slice_size = static_cast<std::uint64_t>(
+			info.num_time_slices) * info.num_bands;
+	const std::size_t value_size = GetValueSize(info.data_type);
+	// The values of a task must be addressable with int counts.
+	int valid = first_pixel + num_pixels <= info.num_pixels
+			&& num_pixels * slice_size * value_size <= INT_MAX
+			&& static_cast<std::uint64_t>(info.pixels_per_chunk) * slice_size
+					<= INT_MAX;
+	if (!valid) {
+		std::cerr << "cannot read pixels [" << first_pixel << ", "
+				<< first_pixel + num_pixels << ") of " << path << " with "
+				<< info.num_pixels << " pixels at task #" << rank << std::endl;
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_MIN, communicator);
+	if (!valid) {
+		return false;
+	}
+
+	MPI_File file;
+	if (MPI_File_open(communicator, path.c_str(), MPI_MODE_RDONLY,
+			MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+		if (rank == 0)
+			std::cerr << "cannot open " << path << std::endl;
+		return false;
+	}
+	const MPI_Datatype value_type = GetMPIDataType(info.data_type);
+	MPI_Datatype file_type = value_type, memory_type = value_type;
+	if (num_pixels > 0) {
+		BuildReadTypes(info, first_pixel, num_pixels, value_type, file_type,
+				memory_type);
+	}
+	values.resize(num_pixels * slice_size * value_size);
+	int succeeded = MPI_File_set_view(file, info.data_offset, value_type,
+			file_type, "native", MPI_INFO_NULL) == MPI_SUCCESS;
+	succeeded = MPI_File_read_at_all(file, 0, values.data(),
+			num_pixels > 0 ? 1 : 0, memory_type, MPI_STATUS_IGNORE)
+			== MPI_SUCCESS && succeeded;
+	MPI_File_close(&file);
+	if (num_pixels > 0) {
+		MPI_Type_free(&file_type);
+		MPI_Type_free(&memory_type);
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &succeeded, 1, MPI_INT, MPI_MIN, communicator);
+	if (!succeeded) {
+		if (rank == 0)
+			std::cerr << "failed to read " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Reads the stored values of a quantized cube without decoding them.
+template<typename T>
+bool ReadQuantized(MPI_Comm communicator, const std::string &path,
+		CubeDataType data_type, std::uint64_t first_pixel,
+		std::uint64_t num_pixels, std::vector<TimeSeries<T>> &time_series,
+		BandQuantization &quantization) {
+	time_series.clear();
+	TileCubeInfo info;
+	if (!ReadSharedInfo(communicator, path, info)) {
+		return false;
+	}
+	if (info.data_type != data_type) {
+		int rank;
+		MPI_Comm_rank(communicator, &rank);
+		if (rank == 0)
+			std::cerr << path << " does not store "
+					<< (data_type == CubeDataType::kInt16 ? "int16" : "uint16")
+					<< " values" << std::endl;
+		return false;
+	}
+	std::vector<char> values;
+	if (!ReadPixelValues(communicator, path, info, first_pixel, num_pixels,
+			values)) {
+		return false;
+	}
+	const std::uint64_t slice_size = static_cast<std::uint64_t>(
+			info.num_time_slices) * info.num_bands;
+	time_series.reserve(num_pixels);
+	for (std::uint64_t p = 0; p < num_pixels; ++p) {
+		std::vector<T> pixel_values(slice_size);
+		std::memcpy(pixel_values.data(),
+				values.data() + p * slice_size * sizeof(T),
+				slice_size * sizeof(T));
+		time_series.push_back(
+				TimeSeries<T>(std::move(pixel_values), info.num_bands));
+	}
+	quantization.scales = info.scales;
+	quantization.offsets = info.offsets;
+	return true;
+}
+
+} /* namespace */
+
+bool TileCube::Write(const std::string &path, const TileCubeInfo &info,
+		const TimeSliceProducer &producer) {
+	if (!IsValid(info)) {
+		std::cerr << "invalid tile cube dimensions for " << path << std::endl;
+		return false;
+	}
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cerr << "cannot open " << path << " for writing" << std::endl;
+		return false;
+	}
+	FileHeader header;
+	std::memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.num_bands = info.num_bands;
+	header.num_time_slices = info.num_time_slices;
+	header.num_pixels = info.num_pixels;
+	header.data_type = static_cast<std::uint32_t>(info.data_type);
+	header.pixels_per_chunk = info.pixels_per_chunk;
+	header.data_offset = GetDataOffset(info.num_bands);
+	std::vector<char> bytes(header.data_offset, 0);
+	std::memcpy(bytes.data(), &header, sizeof(header));
+	std::memcpy(bytes.data() + sizeof(header), info.scales.data(),
+			sizeof(float) * info.num_bands);
+	std::memcpy(bytes.data() + sizeof(header) + sizeof(float) * info.num_bands,
+			info.offsets.data(), sizeof(float) * info.num_bands);
+	out.write(bytes.data(), bytes.size());
+
+	const std::uint64_t num_pixels = info.num_pixels;
+	const std::uint64_t chunk_size = info.pixels_per_chunk;
+	const std::uint64_t slice_size = static_cast<std::uint64_t>(
+			info.num_time_slices) * info.num_bands;
+	const std::size_t value_size = GetValueSize(info.data_type);
+	std::vector<float> time_slice(num_pixels * info.num_bands);
+	std::vector<float*> bands(info.num_bands);
+	for (int band = 0; band < info.num_bands; ++band) {
+		bands[band] = time_slice.data() + band * num_pixels;
+	}
+	std::vector<char> chunk_values;
+	for (int t = 0; t < info.num_time_slices; ++t) {
+		if (!producer(t, bands)) {
+			std::cerr << "failed to load time slice #" << t << " of " << path
+					<< std::endl;
+			return false;
+		}
+		// The bands of a time slice are contiguous in every chunk.
+		for (std::uint64_t chunk_first = 0; chunk_first < num_pixels;
+				chunk_first += chunk_size) {
+			const std::uint64_t chunk_pixels = std::min(chunk_size,
+					num_pixels - chunk_first);
+			chunk_values.resize(info.num_bands * chunk_pixels * value_size);
+			char *value = chunk_values.data();
+			for (int band = 0; band < info.num_bands; ++band) {
+				for (std::uint64_t p = 0; p < chunk_pixels; ++p) {
+					EncodeValue(bands[band][chunk_first + p], info.scales[band],
+							info.offsets[band], info.data_type, value);
+					value += value_size;
+				}
+			}
+			out.seekp(
+					header.data_offset
+							+ (chunk_first * slice_size
+									+ static_cast<std::uint64_t>(t)
+											* info.num_bands * chunk_pixels)
+									* value_size);
+			out.write(chunk_values.data(), chunk_values.size());
+		}
+	}
+	out.close();
+	if (!out) {
+		std::cerr << "failed to write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool TileCube::ReadInfo(const std::string &path, TileCubeInfo &info) {
+	std::vector<char> bytes;
+	if (!ReadHeader(path, bytes)) {
+		return false;
+	}
+	if (!ParseHeader(bytes, info)) {
+		std::cerr << "invalid tile cube: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool TileCube::Read(MPI_Comm communicator, const std::string &path,
+		std::uint64_t first_pixel, std::uint64_t num_pixels,
+		std::vector<TimeSeries<float>> &time_series) {
+	time_series.clear();
+	TileCubeInfo info;
+	std::vector<char> values;
+	if (!ReadSharedInfo(communicator, path, info)
+			|| !ReadPixelValues(communicator, path, info, first_pixel,
+					num_pixels, values)) {
+		return false;
+	}
+
+	const std::uint64_t slice_size = static_cast<std::uint64_t>(
+			info.num_time_slices) * info.num_bands;
+	const std::size_t value_size = GetValueSize(info.data_type);
+	time_series.reserve(num_pixels);
+	const char *value = values.data();
+	for (std::uint64_t p = 0; p < num_pixels; ++p) {
+		std::vector<float> pixel_values(slice_size);
+		for (std::uint64_t i = 0; i < slice_size; ++i) {
+			const int band = i % info.num_bands;
+			pixel_values[i] = DecodeValue(value, info.scales[band],
+					info.offsets[band], info.data_type);
+			value += value_size;
+		}
+		time_series.push_back(
+				TimeSeries<float>(std::move(pixel_values), info.num_bands));
+	}
+	return true;
+}
+
+bool TileCube::Read(MPI_Comm communicator, const std::string &path,
+		std::uint64_t first_pixel, std::uint64_t num_pixels,
+		std::vector<TimeSeries<std::int16_t>> &time_series,
+		BandQuantization &quantization) {
+	return ReadQuantized(communicator, path, CubeDataType::kInt16,
+			first_pixel, num_pixels, time_series, quantization);
+}
+
+bool TileCube::Read(MPI_Comm communicator, const std::string &path,
+		std::uint64_t first_pixel, std::uint64_t num_pixels,
+		std::vector<TimeSeries<std::uint16_t>> &time_series,
+		BandQuantization &quantization) {
+	return ReadQuantized(communicator, path, CubeDataType::kUInt16,
+			first_pixel, num_pixels, time_series, quantization);
+}
+
+} /* namespace remote_sensing */
@@ -0,0 +1,104 @@
+/*
+ * TileCube.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_PHENONET_TILECUBE_H_
+#define SIMPLEGRAPH_PHENONET_TILECUBE_H_
+
+#include "TimeSeries.h"
+
+#include <mpi.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace remote_sensing {
+
+// The type of the values stored in a tile cube.
+enum class CubeDataType : std::uint32_t {
+	kFloat32 = 0,
+	// Quantized values: value = stored * scale + offset, per band.
+	kInt16 = 1,
+	kUInt16 = 2
+};
+
+// The dimensions and encoding of a tile cube.
+struct TileCubeInfo {
+	int num_bands;
+	int num_time_slices;
+	std::uint64_t num_pixels;
+	CubeDataType data_type;
+	// The pixels are stored in chunks of pixels_per_chunk pixels (the last
+	// one may be smaller). 1 stores every time series contiguously, and
+	// num_pixels stores every band of every time slice contiguously.
+	int pixels_per_chunk;
+	// The scale and offset of every band, 1 and 0 for kFloat32.
+	std::vector<float> scales;
+	std::vector<float> offsets;
+	// The file offset of the first value.
+	std::uint64_t data_offset;
+};
+
+/*
+ * A binary file of the time series of a tile of pixels. The file starts
+ * with a header (magic, version, number of bands, time slices and pixels,
+ * data type, pixels per chunk, data offset) followed by the scale and
+ * offset of every band. The values start at data_offset, aligned to 64
+ * bytes: the pixel chunks are stored one after another, and the values of a
+ * chunk of n pixels are ordered by (time slice, band, pixel), i.e. value
+ * (t, b, p) of the chunk is at (t * num_bands + b) * n + p. Values are
+ * stored in the native byte order.
+ *
+ * Read() lets every task of a communicator read the time series of its own
+ * range of pixels with one collective MPI-IO call, so neither text parsing
+ * nor a scatter is on the critical path.
+ */
+class TileCube {
+public:
+	// Loads the bands of one time slice: bands[band] points to num_pixels
+	// values to fill. Returns false on errors.
+	typedef std::function<bool(int time_slice_index,
+			const std::vector<float*> &bands)> TimeSliceProducer;
+
+	// Writes a cube with the dimensions, data type, chunking, scales and
+	// offsets of info (data_offset is ignored), loading the time slices one
+	// at a time with the producer. Quantized values are rounded and clamped
+	// to the range of the data type. Returns false if the producer fails or
+	// the file cannot be written.
+	static bool Write(const std::string &path, const TileCubeInfo &info,
+			const TimeSliceProducer &producer);
+
+	// Reads the header of a cube. Returns false if the file is not a valid
+	// cube.
+	static bool ReadInfo(const std::string &path, TileCubeInfo &info);
+
+	// Reads the time series of the pixels [first_pixel, first_pixel +
+	// num_pixels) of a cube with MPI_File_read_at_all, converting quantized
+	// values to reflectance. This is collective over the communicator, but
+	// the tasks read their own ranges (which may be empty). Returns false on
+	// all tasks if any of them fails.
+	static bool Read(MPI_Comm communicator, const std::string &path,
+			std::uint64_t first_pixel, std::uint64_t num_pixels,
+			std::vector<TimeSeries<float>> &time_series);
+
+	// Reads the time series of the pixels of an int16 (uint16) cube as
+	// stored, without decoding them, along with the scales and offsets of
+	// the bands. They take half the memory of float and can be analyzed
+	// directly (see PhenoNet). Returns false on all tasks if the cube stores
+	// another data type.
+	static bool Read(MPI_Comm communicator, const std::string &path,
+			std::uint64_t first_pixel, std::uint64_t num_pixels,
+			std::vector<TimeSeries<std::int16_t>> &time_series,
+			BandQuantization &quantization);
+	static bool Read(MPI_Comm communicator, const std::string &path,
+			std::uint64_t first_pixel, std::uint64_t num_pixels,
+			std::vector<TimeSeries<std::uint16_t>> &time_series,
+			BandQuantization &quantization);
+};
+
+} /* namespace remote_sensing */
+
+#endif /* SIMPLEGRAPH_PHENONET_TILECUBE_H_ */
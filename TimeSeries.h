@@ -7,55 +7,245 @@
 #ifndef SIMPLEGRAPH_PHENONET_TIMESERIES_H_
 #define SIMPLEGRAPH_PHENONET_TIMESERIES_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
 namespace remote_sensing {
 
+// A read only view of the values of one time slice, one per band.
+template<typename DataType>
+class TimeSlice {
+public:
+	TimeSlice() :
+			data_(nullptr), size_(0) {
+	}
+
+	TimeSlice(const DataType *data, std::size_t size) :
+			data_(data), size_(size) {
+	}
+
+	inline const DataType* begin() const {
+		return data_;
+	}
+
+	inline const DataType* end() const {
+		return data_ + size_;
+	}
+
+	inline const DataType* data() const {
+		return data_;
+	}
+
+	inline std::size_t size() const {
+		return size_;
+	}
+
+	inline bool empty() const {
+		return size_ == 0;
+	}
+
+	inline const DataType& operator[](std::size_t band) const {
+		return data_[band];
+	}
+
+private:
+	const DataType *data_;
+	std::size_t size_;
+};
+
 // A time series contains a list of time slice,
-// each of which includes values from multiple bands.
+// each of which includes values from multiple bands. All values are
+// stored in one contiguous array, time slice by time slice, i.e. the value
+// of band b of time slice t is at t * num_bands + b. The array is either
+// owned by the time series or, for a view, by someone else (e.g. a
+// node-shared window), in which case copying the time series does not copy
+// the values.
 template<typename DataType>
 class TimeSeries {
 public:
-	TimeSeries() {
+	TimeSeries() :
+			view_(nullptr), num_time_slices_(0), num_bands_(0) {
+	}
+
+	// Creates num_time_slices time slices of num_bands values, all 0. The
+	// values are meant to be filled through GetMutableTimeSlice().
+	TimeSeries(std::size_t num_time_slices, std::size_t num_bands) :
+			values_(num_time_slices * num_bands), view_(nullptr), num_time_slices_(
+					num_bands > 0 ? num_time_slices : 0), num_bands_(num_bands) {
+	}
+
+	// Takes the values of all time slices, stored time slice by time slice.
+	// The values of an incomplete last time slice are dropped.
+	TimeSeries(std::vector<DataType> &&values, std::size_t num_bands) :
+			values_(std::move(values)), view_(nullptr), num_time_slices_(
+					num_bands > 0 ? values_.size() / num_bands : 0), num_bands_(
+					num_bands) {
+		values_.resize(num_time_slices_ * num_bands_);
+	}
+
+	// Views num_time_slices time slices of num_bands values stored elsewhere,
+	// which must outlive the view and all its copies.
+	TimeSeries(const DataType *values, std::size_t num_time_slices,
+			std::size_t num_bands) :
+			view_(values), num_time_slices_(
+					num_bands > 0 && values != nullptr ? num_time_slices : 0), num_bands_(
+					num_bands) {
 	}
 
 	~TimeSeries() {
 	}
 
 	inline std::size_t GetNumTimeSlices() const {
-		return time_slices_.size();
+		return num_time_slices_;
 	}
 
 	// The number of bands in each time slice
 	inline std::size_t GetTimeSliceDimension() const {
-		return GetNumTimeSlices() > 0 ? time_slices_[0].size() : 0;
+		return GetNumTimeSlices() > 0 ? num_bands_ : 0;
 	}
 
-	bool AddTimeSlice(const std::vector<DataType> &time_slice) {
-		if (!ValidateTimeSlice(time_slice)) {
-			return false;
+	// Returns an empty time slice if the index is out of range.
+	TimeSlice<DataType> GetTimeSlice(std::size_t time_slice_index) const {
+		if (time_slice_index >= GetNumTimeSlices()) {
+			return TimeSlice<DataType>();
 		}
-		time_slices_.push_back(time_slice);
-		return true;
+		return TimeSlice<DataType>(GetData() + time_slice_index * num_bands_,
+				num_bands_);
 	}
 
-	const std::vector<DataType>* GetTimeSlice(
-			std::size_t time_slice_index) const {
-		if (time_slice_index >= GetNumTimeSlices()) {
+	// Returns the num_bands values of the time slice, or nullptr if the index
+	// is out of range or the time series is a view.
+	DataType* GetMutableTimeSlice(std::size_t time_slice_index) {
+		if (time_slice_index >= GetNumTimeSlices() || IsView()) {
 			return nullptr;
 		}
-		return &time_slices_[time_slice_index];
+		return &values_[time_slice_index * num_bands_];
+	}
+
+	// Returns all values, time slice by time slice.
+	inline const DataType* GetData() const {
+		return IsView() ? view_ : values_.data();
+	}
+
+	inline bool IsView() const {
+		return view_ != nullptr;
 	}
 
 private:
-	std::vector<std::vector<DataType>> time_slices_;
+	// The values of a time series that is not a view.
+	std::vector<DataType> values_;
+	const DataType *view_;
+	std::size_t num_time_slices_;
+	std::size_t num_bands_;
+};
+
+// A read only view of the time series of a pixel whose values are stored
+// elsewhere with any strides, e.g. in a memory-mapped tile cube: the value
+// of band b of time slice t is at
+// data[t * time_slice_stride + b * band_stride].
+template<typename DataType>
+class PixelView {
+public:
+	PixelView() :
+			data_(nullptr), num_time_slices_(0), num_bands_(0), time_slice_stride_(
+					0), band_stride_(0) {
+	}
+
+	PixelView(const DataType *data, std::size_t num_time_slices,
+			std::size_t num_bands, std::size_t time_slice_stride,
+			std::size_t band_stride) :
+			data_(data), num_time_slices_(
+					data != nullptr && num_bands > 0 ? num_time_slices : 0), num_bands_(
+					num_bands), time_slice_stride_(time_slice_stride), band_stride_(
+					band_stride) {
+	}
+
+	// Views the values of a time series, which must outlive the view.
+	explicit PixelView(const TimeSeries<DataType> &time_series) :
+			PixelView(time_series.GetData(), time_series.GetNumTimeSlices(),
+					time_series.GetTimeSliceDimension(),
+					time_series.GetTimeSliceDimension(), 1) {
+	}
+
+	inline std::size_t GetNumTimeSlices() const {
+		return num_time_slices_;
+	}
+
+	inline std::size_t GetTimeSliceDimension() const {
+		return num_time_slices_ > 0 ? num_bands_ : 0;
+	}
+
+	inline const DataType& operator()(std::size_t time_slice_index,
+			std::size_t band) const {
+		return data_[time_slice_index * time_slice_stride_
+				+ band * band_stride_];
+	}
 
-	bool ValidateTimeSlice(const std::vector<DataType> &time_slice) const {
-		if (!time_slices_.empty()
-				&& time_slice.size() != time_slices_[0].size()) {
-			// All time slices should have the same dimension.
+	// Whether the values are laid out as in a TimeSeries, starting at
+	// GetData().
+	inline bool IsContiguous() const {
+		return band_stride_ == 1 && time_slice_stride_ == num_bands_;
+	}
+
+	inline const DataType* GetData() const {
+		return data_;
+	}
+
+	// Returns the time slice, which is gathered into buffer (num_bands
+	// values) unless its bands are contiguous. Returns an empty time slice
+	// if the index is out of range.
+	TimeSlice<DataType> GetTimeSlice(std::size_t time_slice_index,
+			DataType *buffer) const {
+		if (time_slice_index >= num_time_slices_) {
+			return TimeSlice<DataType>();
+		}
+		const DataType *values = data_ + time_slice_index * time_slice_stride_;
+		if (band_stride_ == 1) {
+			return TimeSlice<DataType>(values, num_bands_);
+		}
+		for (std::size_t band = 0; band < num_bands_; ++band) {
+			buffer[band] = values[band * band_stride_];
+		}
+		return TimeSlice<DataType>(buffer, num_bands_);
+	}
+
+	// Copies the values in the order of a TimeSeries.
+	void CopyTo(DataType *values) const {
+		for (std::size_t t = 0; t < num_time_slices_; ++t) {
+			for (std::size_t band = 0; band < num_bands_; ++band) {
+				*values++ = (*this)(t, band);
+			}
+		}
+	}
+
+private:
+	const DataType *data_;
+	std::size_t num_time_slices_;
+	std::size_t num_bands_;
+	std::size_t time_slice_stride_;
+	std::size_t band_stride_;
+};
+
+// The encoding of quantized time series, e.g. surface reflectance delivered
+// as scaled int16: the value of band b is stored * scales[b] + offsets[b].
+struct BandQuantization {
+	std::vector<float> scales;
+	std::vector<float> offsets;
+
+	// Whether all bands share one scale and have no offset, in which case
+	// the stored values are proportional to the values and the cosine
+	// similarity can be computed on them directly.
+	bool IsProportional() const {
+		if (offsets.size() != scales.size()) {
 			return false;
 		}
+		for (std::size_t b = 0; b < scales.size(); ++b) {
+			if (scales[b] != scales[0] || offsets[b] != 0) {
+				return false;
+			}
+		}
 		return true;
 	}
 };
@@ -64,5 +254,7 @@ private:
 
 template class remote_sensing::TimeSeries<int>;
 template class remote_sensing::TimeSeries<float>;
+template class remote_sensing::TimeSeries<std::int16_t>;
+template class remote_sensing::TimeSeries<std::uint16_t>;
 
 #endif /* SIMPLEGRAPH_PHENONET_TIMESERIES_H_ */
@@ -8,9 +8,15 @@
 #define SIMPLEGRAPH_PHENONET_TIMESERIESDECOMPOSITION_H_
 
 #include "Utils.h"
+#include "NodeSharedMemory.h"
 #include "TimeSeries.h"
 
 #include <mpi.h>
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <vector>
 #include <type_traits>
@@ -23,6 +29,17 @@ namespace remote_sensing {
   template <typename T>
     class TimeSeriesDecomposition {
   public:
+  // How DistributeData() moves the data between the tasks. Both give the
+  // same time series.
+  enum class DistributionMethod {
+    // One MPI_Scatterv per time slice and band, rooted at its task.
+    kScatterPerTimeSlice,
+    // Each task packs its time slices for all tasks and exchanges them with
+    // one MPI_Alltoallv per round of time slices (one round unless the
+    // counts would overflow int).
+    kAllToAll
+  };
+
   // This class assumes the following:
   // 1) Tasks may be assigned to distribute the data for a number of time
   //    slices. This information should be passed by
@@ -43,19 +60,41 @@ namespace remote_sensing {
   //    the full time series data for elements specified by
   //    decomposition_schema. e.g. pixels of range [xx, yy) in a scene of
   //    a satellite image.
+  // 6) The tasks and ranks refer to communicator (MPI_COMM_WORLD by
+  //    default), e.g. the communicator of a node group planned by
+  //    SpaceTimeDecomposition.
  TimeSeriesDecomposition(const std::vector<int> &time_slice_index_to_task,
 			 const std::vector<std::vector<T*>> &data, int num_bands,
 			 int num_pixels,
 			 utils::DecompositionSchema decomposition_schema,
-			 int task_rank) :
+			 int task_rank, MPI_Comm communicator = MPI_COMM_WORLD) :
   time_slice_index_to_task_(time_slice_index_to_task), data_(data), num_pixels_(
 										num_pixels), num_bands_(num_bands), decomposition_schema_(
-																	  decomposition_schema), rank_(task_rank) {
+																	  decomposition_schema), rank_(task_rank), communicator_(
+																								 communicator), method_(
+																											DistributionMethod::kAllToAll), shared_memory_(false) {
   }
   
   virtual ~TimeSeriesDecomposition() {
   }
 
+  // Loads the bands of one time slice assigned to this task:
+  // bands[band] points to num_pixels values to fill. Returns false on
+  // errors.
+  typedef std::function<bool(int time_slice_index,
+			     const std::vector<T*> &bands)> TimeSliceProducer;
+
+  // For DistributeData(producer, chunk_size), which loads the data itself.
+  TimeSeriesDecomposition(const std::vector<int> &time_slice_index_to_task,
+			  int num_bands, int num_pixels,
+			  utils::DecompositionSchema decomposition_schema,
+			  int task_rank, MPI_Comm communicator = MPI_COMM_WORLD) :
+    TimeSeriesDecomposition(time_slice_index_to_task,
+			    std::vector<std::vector<T*>>(), num_bands,
+			    num_pixels, decomposition_schema, task_rank,
+			    communicator) {
+  }
+
   TimeSeriesDecomposition(const TimeSeriesDecomposition &other) = delete;
   TimeSeriesDecomposition(TimeSeriesDecomposition &&other) = delete;
 
@@ -73,21 +112,8 @@ namespace remote_sensing {
 		  << " v.s. " << data_.size() << std::endl;
       }
       return false;
-    } else {
-      for (int i = 0; i < decomposition_schema_.pool_size; ++i) {
-	if (decomposition_schema_.displacements[i]
-	    + decomposition_schema_.counts[i] > num_pixels_) {
-	  if (rank_ == decomposition_schema_.root) {
-	    std::cerr << "invalid decomposition_schema. The"
-		      << "assigned data for task #" << i
-		      << " will be out of bound: "
-		      << (decomposition_schema_.displacements[i]
-			  + decomposition_schema_.counts[i])
-		      << " v.s. " << num_pixels_ << std::endl;
-	  }
-	  return false;
-	}
-      }
+    } else if (!ValidateSchema()) {
+      return false;
     }
 
     const int num_time_slices = static_cast<int>(data_.size());
@@ -109,46 +135,178 @@ namespace remote_sensing {
       }
     }
 
-    std::vector<std::vector<T*>> data(num_time_slices,
-				      std::vector<T*>(num_bands_, nullptr));
-    auto clean_buffer = [&data]() {
-      for (auto &slice : data) {
-	for (auto &band : slice) {
-	  delete band;
+    const MPI_Datatype data_type = GetDataType();
+    if (data_type == MPI_DATATYPE_NULL) {
+      // Unsupported data type.
+      if (rank_ == decomposition_schema_.root) {
+	std::cerr << "The input data is not supported."
+		  <<"Please use one of the following: float, double, int, int16_t, uint16_t.\n";
+      }
+      return false;
+    }
+    if (method_ == DistributionMethod::kAllToAll
+	&& static_cast<long long>(num_bands_) * num_pixels_ <= INT_MAX) {
+      return DistributeAllToAll(data_type);
+    }
+    return DistributeScatter();
+  }
+
+  // Distributes the data like DistributeData(), while loading it: the time
+  // slices are exchanged in chunks of chunk_size (global) time slices with
+  // MPI_Ialltoallv, and the time slices of this task in the next chunk are
+  // loaded with the producer while the previous chunks are in flight (two
+  // chunks are buffered). Each loaded time slice is copied straight into
+  // the send buffer. All tasks return false if the producer failed on any
+  // of them.
+  bool DistributeData(const TimeSliceProducer &producer, int chunk_size) {
+    if (time_slice_index_to_task_.empty()) {
+      if (rank_ == decomposition_schema_.root) {
+	std::cerr << "No input data provided.\n";
+      }
+      return false;
+    }
+    const MPI_Datatype data_type = GetDataType();
+    if (data_type == MPI_DATATYPE_NULL) {
+      if (rank_ == decomposition_schema_.root) {
+	std::cerr << "The input data is not supported."
+		  <<"Please use one of the following: float, double, int, int16_t, uint16_t.\n";
+      }
+      return false;
+    }
+    if (!ValidateSchema() || !ValidateTasks()) {
+      return false;
+    }
+    const int num_time_slices = static_cast<int>(time_slice_index_to_task_.size());
+    chunk_size = std::min(std::max(chunk_size, 1), GetMaxRoundSize());
+    std::vector<T*> values;
+    if (!InitializeTimeSeries(values)) {
+      return false;
+    }
+
+    // The time slice of this task being loaded, by band.
+    std::vector<T> time_slice(static_cast<std::size_t>(num_bands_) * num_pixels_);
+    std::vector<T*> bands(num_bands_);
+    for (int band = 0; band < num_bands_; ++band) {
+      bands[band] = time_slice.data() + static_cast<std::size_t>(band) * num_pixels_;
+    }
+    Exchange exchanges[2];
+    bool in_flight[2] = { false, false };
+    bool succeeded = true;
+    auto progress = [&exchanges, &in_flight]() {
+      // Lets MPI progress the transfers while the data is being loaded.
+      for (int k = 0; k < 2; ++k) {
+	if (in_flight[k]) {
+	  int done = 0;
+	  MPI_Test(&exchanges[k].request, &done, MPI_STATUS_IGNORE);
 	}
       }
     };
-    
-    for (int i = 0; i < num_time_slices; ++i) {
-      for (int j = 0; j < num_bands_; j++) {
-	data[i][j] = DistributeData(data_[i][j], decomposition_schema_,
-				    rank_, time_slice_index_to_task_[i]);
-	if (data[i][j] == nullptr) {
-	  clean_buffer();
-	  return false;
+    auto complete = [&](int k) {
+      if (in_flight[k]) {
+	succeeded = MPI_Wait(&exchanges[k].request, MPI_STATUS_IGNORE)
+	  == MPI_SUCCESS && succeeded;
+	UnpackExchange(exchanges[k], values);
+	in_flight[k] = false;
+      }
+    };
+
+    for (int first = 0, chunk = 0; first < num_time_slices;
+	 first += chunk_size, ++chunk) {
+      Exchange &exchange = exchanges[chunk % 2];
+      // Reuses the buffers of the chunk before the previous one.
+      complete(chunk % 2);
+      PrepareExchange(first, std::min(first + chunk_size, num_time_slices),
+		      exchange);
+      int slice_rank = 0;
+      for (int i = exchange.first; i < exchange.last; ++i) {
+	if (time_slice_index_to_task_[i] != rank_) {
+	  continue;
+	}
+	// The other tasks still take part in the exchanges after a
+	// failure, which is reported once all data is received.
+	if (succeeded && !producer(i, bands)) {
+	  std::cerr << "Failed to load time slice #" << i << " at task #"
+		    << rank_ << std::endl;
+	  succeeded = false;
 	}
+	PackTimeSlice(bands, slice_rank++, exchange);
+	progress();
       }
-    }
-    
-    time_series_.resize(decomposition_schema_.counts[rank_]);
-    for (int i = 0; i < decomposition_schema_.counts[rank_]; ++i) {
-      for (int j = 0; j < num_time_slices; ++j) {
-	std::vector<T> time_slice(num_bands_);
-	for (int band = 0; band < num_bands_; ++band) {
-	  time_slice[band] = data[j][band][i];
+      if (MPI_Ialltoallv(exchange.send_buffer.data(), exchange.send_counts.data(),
+			 exchange.send_displacements.data(), data_type,
+			 exchange.receive_buffer.data(), exchange.receive_counts.data(),
+			 exchange.receive_displacements.data(), data_type,
+			 communicator_, &exchange.request) != MPI_SUCCESS) {
+	std::cerr << "Failed to exchange time slices #" << exchange.first
+		  << " to #" << exchange.last - 1 << " at task #" << rank_
+		  << std::endl;
+	// The previous chunk still uses its buffers, which are freed on
+	// return. Collective requests cannot be cancelled.
+	Exchange &previous = exchanges[(chunk + 1) % 2];
+	if (in_flight[(chunk + 1) % 2]) {
+	  MPI_Wait(&previous.request, MPI_STATUS_IGNORE);
 	}
-	time_series_[i].AddTimeSlice(time_slice);
+	return false;
       }
+      in_flight[chunk % 2] = true;
     }
+    // The remaining chunks complete in order.
+    const int num_chunks = (num_time_slices + chunk_size - 1) / chunk_size;
+    complete(num_chunks % 2);
+    complete((num_chunks + 1) % 2);
 
-    clean_buffer();
+    int all_succeeded = succeeded ? 1 : 0;
+    MPI_Allreduce(MPI_IN_PLACE, &all_succeeded, 1, MPI_INT, MPI_MIN,
+		  communicator_);
+    if (!all_succeeded) {
+      return false;
+    }
+    FinalizeTimeSeries();
     return true;
   }
-  
+
+  // The default is DistributionMethod::kAllToAll.
+  void SetDistributionMethod(DistributionMethod method) {
+    method_ = method;
+  }
+
+  // Enables or disables (the default) the hybrid mode: the time series of
+  // all tasks on a node are received into one node-shared window (see
+  // NodeSharedMemory), so a node holds one copy of its pixels and the time
+  // series handed out are views of the window, which stays valid as long as
+  // this object exists and does not distribute again.
+  void SetSharedMemory(bool enabled) {
+    shared_memory_ = enabled;
+  }
+
+  // The time series of the pixels of this task. They are views in the
+  // hybrid mode, so the copy is cheap.
   std::vector<TimeSeries<T>> GetTimeSeries() const {
     return time_series_;
   }
 
+  // In the hybrid mode, views of the time series of the pixels of all tasks
+  // on this node, task by task in the order of their ranks. The pixels are
+  // contiguous in the image if the decomposition schema assigns consecutive
+  // ranges to consecutive ranks. Empty otherwise.
+  std::vector<TimeSeries<T>> GetNodeTimeSeries() const {
+    std::vector<TimeSeries<T>> time_series;
+    const std::size_t num_time_slices = time_slice_index_to_task_.size();
+    const std::size_t pixel_size = num_time_slices * num_bands_;
+    if (!shared_memory_ || pixel_size == 0) {
+      return time_series;
+    }
+    for (int task = 0; task < node_memory_.GetNodeSize(); ++task) {
+      std::size_t size;
+      const T *values = static_cast<const T*>(node_memory_.GetTaskMemory(task, size));
+      for (std::size_t i = 0; i < size / sizeof(T) / pixel_size; ++i) {
+	time_series.push_back(TimeSeries<T>(values + i * pixel_size,
+					    num_time_slices, num_bands_));
+      }
+    }
+    return time_series;
+  }
+
 private:
   // Stores the map from the time slices to the tasks that will handle them.
   const std::vector<int> time_slice_index_to_task_;
@@ -165,9 +323,298 @@ private:
   const utils::DecompositionSchema decomposition_schema_;
   // Rank of the task.
   const int rank_;
+  // The communicator of the tasks.
+  const MPI_Comm communicator_;
+  DistributionMethod method_;
+  // Whether the time series are stored in node_memory_.
+  bool shared_memory_;
+  NodeSharedMemory node_memory_;
   // The time series data.
   std::vector<TimeSeries<T>> time_series_;
   
+  // The buffers of the exchange of the time slices [first, last).
+  struct Exchange {
+    int first, last;
+    std::vector<int> send_counts, send_displacements;
+    std::vector<int> receive_counts, receive_displacements;
+    std::vector<T> send_buffer, receive_buffer;
+    MPI_Request request;
+  };
+
+  bool ValidateSchema() const {
+    for (int i = 0; i < decomposition_schema_.pool_size; ++i) {
+      if (decomposition_schema_.displacements[i]
+	  + decomposition_schema_.counts[i] > num_pixels_) {
+	if (rank_ == decomposition_schema_.root) {
+	  std::cerr << "invalid decomposition_schema. The"
+		    << "assigned data for task #" << i
+		    << " will be out of bound: "
+		    << (decomposition_schema_.displacements[i]
+			+ decomposition_schema_.counts[i])
+		    << " v.s. " << num_pixels_ << std::endl;
+	}
+	return false;
+      }
+    }
+    return true;
+  }
+
+  // Checks that every time slice is assigned to a task of the pool.
+  bool ValidateTasks() const {
+    for (std::size_t i = 0; i < time_slice_index_to_task_.size(); ++i) {
+      if (time_slice_index_to_task_[i] < 0
+	  || time_slice_index_to_task_[i] >= decomposition_schema_.pool_size) {
+	if (rank_ == decomposition_schema_.root) {
+	  std::cerr << "Invalid task #" << time_slice_index_to_task_[i]
+		    << " for time slice #" << i << std::endl;
+	}
+	return false;
+      }
+    }
+    return true;
+  }
+
+  // The largest number of time slices that can be exchanged at once: an
+  // exchange sends at most round_size * num_bands_ * num_pixels_ values,
+  // which must fit in int.
+  int GetMaxRoundSize() const {
+    const int num_time_slices = std::max(static_cast<int>(time_slice_index_to_task_.size()), 1);
+    const long long slice_size = static_cast<long long>(num_bands_) * num_pixels_;
+    if (slice_size <= 0) {
+      return num_time_slices;
+    }
+    return static_cast<int>(std::min<long long>(num_time_slices,
+						std::max(INT_MAX / slice_size, 1LL)));
+  }
+
+  // Allocates the time series of the pixels of this task, in the
+  // node-shared window in the hybrid mode, and sets values[pixel] to where
+  // the time series of each pixel starts. This is collective in the hybrid
+  // mode.
+  bool InitializeTimeSeries(std::vector<T*> &values) {
+    const std::size_t num_time_slices = time_slice_index_to_task_.size();
+    const std::size_t pixel_size = num_time_slices * num_bands_;
+    const int num_local_pixels = decomposition_schema_.counts[rank_];
+    time_series_.clear();
+    values.assign(num_local_pixels, nullptr);
+    if (shared_memory_) {
+      if (!node_memory_.Allocate(communicator_,
+				 sizeof(T) * pixel_size * num_local_pixels)) {
+	return false;
+      }
+      T *memory = static_cast<T*>(node_memory_.GetMemory());
+      for (int pixel = 0; pixel < num_local_pixels; ++pixel) {
+	values[pixel] = memory + pixel * pixel_size;
+      }
+    } else {
+      node_memory_.Free();
+      time_series_.resize(num_local_pixels);
+      for (int pixel = 0; pixel < num_local_pixels; ++pixel) {
+	time_series_[pixel] = TimeSeries<T>(num_time_slices, num_bands_);
+	values[pixel] = time_series_[pixel].GetMutableTimeSlice(0);
+      }
+    }
+    return true;
+  }
+
+  // Makes the time series views of the node-shared window in the hybrid
+  // mode, once all tasks of the node have filled their parts.
+  void FinalizeTimeSeries() {
+    if (!shared_memory_) {
+      return;
+    }
+    node_memory_.Synchronize();
+    const std::size_t num_time_slices = time_slice_index_to_task_.size();
+    const T *memory = static_cast<const T*>(node_memory_.GetMemory());
+    time_series_.resize(decomposition_schema_.counts[rank_]);
+    for (std::size_t pixel = 0; pixel < time_series_.size(); ++pixel) {
+      time_series_[pixel] = TimeSeries<T>(memory + pixel * num_time_slices * num_bands_,
+					  num_time_slices, num_bands_);
+    }
+  }
+
+  // Computes the counts of the exchange of the time slices [first, last)
+  // and sizes its buffers. The values sent to each task are ordered by
+  // (time slice, band, pixel).
+  void PrepareExchange(int first, int last, Exchange &exchange) const {
+    const int pool_size = decomposition_schema_.pool_size;
+    const std::vector<int> &counts = decomposition_schema_.counts;
+    exchange.first = first;
+    exchange.last = last;
+    std::vector<int> num_task_time_slices(pool_size, 0);
+    for (int i = first; i < last; ++i) {
+      ++num_task_time_slices[time_slice_index_to_task_[i]];
+    }
+    exchange.send_counts.resize(pool_size);
+    exchange.send_displacements.resize(pool_size);
+    exchange.receive_counts.resize(pool_size);
+    exchange.receive_displacements.resize(pool_size);
+    int send_size = 0, receive_size = 0;
+    for (int task = 0; task < pool_size; ++task) {
+      exchange.send_counts[task] = num_task_time_slices[rank_] * num_bands_ * counts[task];
+      exchange.send_displacements[task] = send_size;
+      send_size += exchange.send_counts[task];
+      exchange.receive_counts[task] = num_task_time_slices[task] * num_bands_ * counts[rank_];
+      exchange.receive_displacements[task] = receive_size;
+      receive_size += exchange.receive_counts[task];
+    }
+    exchange.send_buffer.resize(send_size);
+    exchange.receive_buffer.resize(receive_size);
+  }
+
+  // Copies the bands of a time slice of this task, the slice_rank-th one
+  // in the exchange, to the parts of the send buffer of every task.
+  void PackTimeSlice(const std::vector<T*> &bands, int slice_rank,
+		     Exchange &exchange) const {
+    const std::vector<int> &counts = decomposition_schema_.counts;
+    const std::vector<int> &displacements = decomposition_schema_.displacements;
+    for (int task = 0; task < decomposition_schema_.pool_size; ++task) {
+      T *out = exchange.send_buffer.data() + exchange.send_displacements[task]
+	+ static_cast<std::size_t>(slice_rank) * num_bands_ * counts[task];
+      for (int band = 0; band < num_bands_; ++band) {
+	const T *pixels = bands[band] + displacements[task];
+	out = std::copy(pixels, pixels + counts[task], out);
+      }
+    }
+  }
+
+  // Copies a received time slice, whose bands are num_pixels values apart,
+  // into the time series of the pixels from offset on. The bands of a pixel
+  // are written together, unrolled for the common band counts (see
+  // utils::DispatchNumBands).
+  template<std::size_t NumBands>
+  struct TimeSliceUnpacker {
+    static void Run(const T *in, std::size_t runtime_num_bands,
+		    std::size_t num_pixels, std::size_t offset,
+		    const std::vector<T*> &values) {
+      const std::size_t num_bands = utils::GetNumBands<NumBands>(runtime_num_bands);
+      for (std::size_t pixel = 0; pixel < num_pixels; ++pixel) {
+	T *out = values[pixel] + offset;
+	for (std::size_t band = 0; band < num_bands; ++band) {
+	  out[band] = in[band * num_pixels + pixel];
+	}
+      }
+    }
+  };
+
+  // Copies the received time slices into the time series of the pixels.
+  void UnpackExchange(const Exchange &exchange,
+		      const std::vector<T*> &values) const {
+    const std::size_t num_local_pixels = decomposition_schema_.counts[rank_];
+    const std::size_t num_bands = num_bands_;
+    for (int task = 0; task < decomposition_schema_.pool_size; ++task) {
+      const T *in = exchange.receive_buffer.data()
+	+ exchange.receive_displacements[task];
+      for (int i = exchange.first; i < exchange.last; ++i) {
+	if (time_slice_index_to_task_[i] != task) {
+	  continue;
+	}
+	utils::DispatchNumBands<TimeSliceUnpacker>(num_bands, in,
+						   num_bands, num_local_pixels,
+						   static_cast<std::size_t>(i) * num_bands,
+						   values);
+	in += num_bands * num_local_pixels;
+      }
+    }
+  }
+
+  // Distributes all time slices with MPI_Alltoallv, in as few rounds as
+  // the int counts allow.
+  bool DistributeAllToAll(MPI_Datatype data_type) {
+    if (!ValidateTasks()) {
+      return false;
+    }
+    const int num_time_slices = static_cast<int>(data_.size());
+    const int round_size = GetMaxRoundSize();
+    std::vector<T*> values;
+    if (!InitializeTimeSeries(values)) {
+      return false;
+    }
+    Exchange exchange;
+    for (int first = 0; first < num_time_slices; first += round_size) {
+      PrepareExchange(first, std::min(first + round_size, num_time_slices),
+		      exchange);
+      int slice_rank = 0;
+      for (int i = exchange.first; i < exchange.last; ++i) {
+	if (time_slice_index_to_task_[i] == rank_) {
+	  PackTimeSlice(data_[i], slice_rank++, exchange);
+	}
+      }
+      const int status = MPI_Alltoallv(exchange.send_buffer.data(), exchange.send_counts.data(),
+				       exchange.send_displacements.data(), data_type,
+				       exchange.receive_buffer.data(), exchange.receive_counts.data(),
+				       exchange.receive_displacements.data(), data_type,
+				       communicator_);
+      if (status != MPI_SUCCESS) {
+	return false;
+      }
+      UnpackExchange(exchange, values);
+    }
+    FinalizeTimeSeries();
+    return true;
+  }
+
+  // Distributes the time slices with one MPI_Scatterv per time slice and
+  // band.
+  bool DistributeScatter() {
+    const int num_time_slices = static_cast<int>(data_.size());
+    std::vector<std::vector<T*>> data(num_time_slices,
+				      std::vector<T*>(num_bands_, nullptr));
+    auto clean_buffer = [&data]() {
+      for (auto &slice : data) {
+	for (auto &band : slice) {
+	  delete[] band;
+	}
+      }
+    };
+    
+    for (int i = 0; i < num_time_slices; ++i) {
+      for (int j = 0; j < num_bands_; j++) {
+	data[i][j] = DistributeData(data_[i][j], decomposition_schema_,
+				    rank_, time_slice_index_to_task_[i]);
+	if (data[i][j] == nullptr) {
+	  clean_buffer();
+	  return false;
+	}
+      }
+    }
+    
+    // Each time series is built in one contiguous buffer.
+    std::vector<T*> values;
+    if (!InitializeTimeSeries(values)) {
+      clean_buffer();
+      return false;
+    }
+    for (int i = 0; i < decomposition_schema_.counts[rank_]; ++i) {
+      for (int j = 0; j < num_time_slices; ++j) {
+	T *time_slice = values[i] + static_cast<std::size_t>(j) * num_bands_;
+	for (int band = 0; band < num_bands_; ++band) {
+	  time_slice[band] = data[j][band][i];
+	}
+      }
+    }
+    FinalizeTimeSeries();
+
+    clean_buffer();
+    return true;
+  }
+
+  static MPI_Datatype GetDataType() {
+    if (std::is_same<T, float>::value) {
+      return MPI_FLOAT;
+    } else if (std::is_same<T, double>::value) {
+      return MPI_DOUBLE;
+    } else if (std::is_same<T, int>::value) {
+      return MPI_INT;
+    } else if (std::is_same<T, std::int16_t>::value) {
+      // Quantized values, e.g. scaled reflectance, half the volume of float.
+      return MPI_SHORT;
+    } else if (std::is_same<T, std::uint16_t>::value) {
+      return MPI_UNSIGNED_SHORT;
+    }
+    return MPI_DATATYPE_NULL;
+  }
+
   // Distributes the data of one time slice between tasks. The assigned
   // data will be stored in the returned address. The caller should
   // take ownership of the pointer. data should be significant at root.
@@ -181,18 +628,12 @@ private:
     }
 
     T* receive_buffer = nullptr;
-    MPI_Datatype data_type;
-    if (std::is_same<T, float>::value) {
-      data_type = MPI_FLOAT;
-    } else if (std::is_same<T, double>::value) {
-      data_type = MPI_DOUBLE;
-    } else if (std::is_same<T, int>::value) {
-      data_type = MPI_INT;
-    } else {
+    const MPI_Datatype data_type = GetDataType();
+    if (data_type == MPI_DATATYPE_NULL) {
       // Unsupported data type.
       if (rank == decomposition_schema.root) {
 	std::cerr << "The input data is not supported."
-		  <<"Please use one of the following: float, double, int.\n";
+		  <<"Please use one of the following: float, double, int, int16_t, uint16_t.\n";
       } 
       return receive_buffer;
     }
@@ -201,9 +642,9 @@ private:
     const int status = MPI_Scatterv(data, decomposition_schema.counts.data(),
 				    decomposition_schema.displacements.data(), data_type, receive_buffer,
 				    decomposition_schema.counts[rank], data_type, root,
-				    MPI_COMM_WORLD);
+				    communicator_);
     if (status != MPI_SUCCESS) {
-      delete receive_buffer;
+      delete[] receive_buffer;
       receive_buffer = nullptr;
     }
     return receive_buffer;
@@ -8,6 +8,8 @@
 #define SIMPLEGRAPH_PHENONET_UTILS_H_
 
 #include <math.h>
+#include <cstddef>
+#include <utility>
 #include <vector>
 
 namespace remote_sensing {
@@ -30,8 +32,10 @@ struct DecompositionSchema {
 	}
 };
 
-template<typename T>
-float SimilarityCosine(const std::vector<T> &v1, const std::vector<T> &v2) {
+// Accepts any containers with size() and operator[], e.g. std::vector and
+// TimeSlice.
+template<typename Slice1, typename Slice2>
+float SimilarityCosine(const Slice1 &v1, const Slice2 &v2) {
 	float ret = 0, sum1 = 0, sum2 = 0;
 	if (v1.size() != v2.size()) {
 		// The two vectors need to have the same dimension.
@@ -48,6 +52,36 @@ float SimilarityCosine(const std::vector<T> &v1, const std::vector<T> &v2) {
 	return ret / sqrt(sum1) / sqrt(sum2);
 }
 
+// The kernels over the bands of a time slice are specialized for the band
+// counts of the common sensors: 7 (Landsat surface reflectance), 10 and 13
+// (Sentinel-2). Their loops over the bands then have a compile time trip
+// count, which the compiler fully unrolls. Kernel<N> must have a static
+// Run() method; Kernel<0> is the generic kernel for any other count.
+template<std::size_t NumBands>
+constexpr std::size_t GetNumBands(std::size_t num_bands) {
+	return NumBands > 0 ? NumBands : num_bands;
+}
+
+// Calls Kernel<num_bands>::Run(args...) if num_bands is specialized, or
+// Kernel<0>::Run(args...) otherwise.
+template<template<std::size_t> class Kernel, typename ... Args>
+inline void DispatchNumBands(std::size_t num_bands, Args &&... args) {
+	switch (num_bands) {
+	case 7:
+		Kernel<7>::Run(std::forward<Args>(args)...);
+		break;
+	case 10:
+		Kernel<10>::Run(std::forward<Args>(args)...);
+		break;
+	case 13:
+		Kernel<13>::Run(std::forward<Args>(args)...);
+		break;
+	default:
+		Kernel<0>::Run(std::forward<Args>(args)...);
+		break;
+	}
+}
+
 // Finds the element in the given range [start_pos, end_pos) that has the
 // largest moving average. Returns an out of range index on errors.
 int FindMaxValueIndexMovingAverage(const std::vector<float> &values,
@@ -0,0 +1,314 @@
+/*
+ * WorkStealingScheduler.cpp
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#include "WorkStealingScheduler.h"
+
+#include <algorithm>
+#include <climits>
+#include <iostream>
+
+namespace remote_sensing {
+
+namespace {
+
+enum MessageTag {
+	// An empty request for a chunk.
+	kChunkRequestTag = 1,
+	// The answer to a request: the chunk and its number of pixels, or -1 and
+	// 0 if the task has no chunks left.
+	kChunkTag,
+	// The time series of the pixels of a chunk.
+	kChunkValuesTag,
+	// The chunk followed by the results of its pixels.
+	kResultsTag
+};
+
+// The MPI type of the values.
+template<typename T>
+MPI_Datatype GetDataType();
+
+template<>
+MPI_Datatype GetDataType<float>() {
+	return MPI_FLOAT;
+}
+
+template<>
+MPI_Datatype GetDataType<std::int16_t>() {
+	return MPI_SHORT;
+}
+
+template<>
+MPI_Datatype GetDataType<std::uint16_t>() {
+	return MPI_UNSIGNED_SHORT;
+}
+
+} /* namespace */
+
+template<typename T>
+WorkStealingScheduler<T>::WorkStealingScheduler(
+		std::vector<TimeSeries<T>> &&time_series, int num_pixels_per_chunk,
+		MPI_Comm communicator) :
+		communicator_(communicator), num_pixels_per_chunk_(
+				std::max(num_pixels_per_chunk, 1)), num_pixels_(
+				time_series.size()), num_time_slices_(0), num_bands_(0), valid_(
+				true), data_(nullptr), num_stolen_chunks_(0), run_communicator_(MPI_COMM_NULL), front_(
+				0), back_(0), num_pending_results_(0), failed_(false) {
+	MPI_Comm_rank(communicator_, &rank_);
+	MPI_Comm_size(communicator_, &size_);
+	if (!time_series.empty()) {
+		num_time_slices_ = time_series[0].GetNumTimeSlices();
+		num_bands_ = time_series[0].GetTimeSliceDimension();
+	}
+	for (const auto &pixel_time_series : time_series) {
+		valid_ = valid_
+				&& pixel_time_series.GetNumTimeSlices() == num_time_slices_
+				&& pixel_time_series.GetTimeSliceDimension() == num_bands_;
+	}
+	const std::size_t pixel_size = num_time_slices_ * num_bands_;
+	bool contiguous_view = valid_ && !time_series.empty();
+	for (std::size_t i = 0; contiguous_view && i < num_pixels_; ++i) {
+		contiguous_view = time_series[i].IsView()
+				&& time_series[i].GetData()
+						== time_series[0].GetData() + i * pixel_size;
+	}
+	if (contiguous_view) {
+		data_ = time_series[0].GetData();
+	} else if (valid_) {
+		values_.reserve(num_pixels_ * pixel_size);
+		for (auto &pixel_time_series : time_series) {
+			values_.insert(values_.end(), pixel_time_series.GetData(),
+					pixel_time_series.GetData() + pixel_size);
+			// Releases the values as soon as they are copied.
+			pixel_time_series = TimeSeries<T>();
+		}
+		data_ = values_.data();
+	}
+	results_.assign(num_pixels_, -1);
+}
+
+template<typename T>
+WorkStealingScheduler<T>::~WorkStealingScheduler() {
+}
+
+template<typename T>
+bool WorkStealingScheduler<T>::Run(const ChunkProcessor &process_chunk) {
+	num_stolen_chunks_ = 0;
+	if (!ValidateDimensions()) {
+		return false;
+	}
+	MPI_Comm_dup(communicator_, &run_communicator_);
+	front_ = 0;
+	back_ = (num_pixels_ + num_pixels_per_chunk_ - 1) / num_pixels_per_chunk_;
+	num_pending_results_ = 0;
+	failed_ = false;
+	const std::size_t pixel_size = num_time_slices_ * num_bands_;
+
+	// Processes the chunks of this task from the front.
+	while (front_ < back_) {
+		const int chunk = front_++;
+		const std::size_t first_pixel =
+				static_cast<std::size_t>(chunk) * num_pixels_per_chunk_;
+		const std::vector<int> results = ProcessChunk(process_chunk,
+				data_ + first_pixel * pixel_size, GetChunkSize(chunk));
+		std::copy(results.begin(), results.end(),
+				results_.begin() + first_pixel);
+		ServeMessages();
+	}
+
+	// Steals the chunks left by the other tasks. Chunks are never given back,
+	// so a task that has none left is not asked again.
+	std::vector<T> values;
+	std::size_t chunk_size;
+	for (int k = 1; k < size_; ++k) {
+		const int task = (rank_ + k) % size_;
+		int chunk;
+		while ((chunk = StealChunk(task, values, chunk_size)) >= 0) {
+			sent_results_.push_back(
+					ProcessChunk(process_chunk, values.data(), chunk_size));
+			std::vector<int> &results = sent_results_.back();
+			results.insert(results.begin(), chunk);
+			send_requests_.push_back(MPI_REQUEST_NULL);
+			MPI_Isend(results.data(), results.size(), MPI_INT, task,
+					kResultsTag, run_communicator_, &send_requests_.back());
+			++num_stolen_chunks_;
+		}
+	}
+
+	// Waits for the results of the chunks taken by others.
+	while (num_pending_results_ > 0) {
+		MPI_Status status;
+		MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, run_communicator_, &status);
+		ServeMessage(status);
+	}
+
+	// Answers the requests of the tasks that are still stealing until all
+	// tasks are done.
+	MPI_Request barrier;
+	MPI_Ibarrier(run_communicator_, &barrier);
+	for (int done = 0; !done;) {
+		MPI_Test(&barrier, &done, MPI_STATUS_IGNORE);
+		if (!done)
+			ServeMessages();
+	}
+	MPI_Waitall(send_requests_.size(), send_requests_.data(),
+			MPI_STATUSES_IGNORE);
+	send_requests_.clear();
+	sent_results_.clear();
+	MPI_Comm_free(&run_communicator_);
+
+	int succeeded = failed_ ? 0 : 1;
+	MPI_Allreduce(MPI_IN_PLACE, &succeeded, 1, MPI_INT, MPI_MIN,
+			communicator_);
+	if (!succeeded && rank_ == 0) {
+		std::cerr << "A chunk did not get one result per pixel.\n";
+	}
+	return succeeded;
+}
+
+template<typename T>
+bool WorkStealingScheduler<T>::ValidateDimensions() {
+	// The largest and (negated) smallest dimensions over all tasks. Tasks
+	// without pixels do not count.
+	long long dimensions[4] = { LLONG_MIN, LLONG_MIN, LLONG_MIN, LLONG_MIN };
+	if (num_pixels_ > 0) {
+		dimensions[0] = num_time_slices_;
+		dimensions[1] = num_bands_;
+		dimensions[2] = -dimensions[0];
+		dimensions[3] = -dimensions[1];
+	}
+	int valid = valid_ ? 1 : 0;
+	MPI_Allreduce(MPI_IN_PLACE, dimensions, 4, MPI_LONG_LONG, MPI_MAX,
+			communicator_);
+	MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_MIN, communicator_);
+	if (dimensions[0] != LLONG_MIN) {
+		// The values of a chunk must fit in one message.
+		valid = valid && dimensions[0] == -dimensions[2]
+				&& dimensions[1] == -dimensions[3]
+				&& static_cast<unsigned long long>(num_pixels_per_chunk_)
+						* dimensions[0] * dimensions[1] <= INT_MAX;
+	}
+	if (!valid && rank_ == 0) {
+		std::cerr << "The time series of all pixels must have the same "
+				<< "dimensions and fit in chunks of " << num_pixels_per_chunk_
+				<< " pixels.\n";
+	}
+	return valid;
+}
+
+template<typename T>
+std::vector<int> WorkStealingScheduler<T>::ProcessChunk(
+		const ChunkProcessor &process_chunk, const T *values,
+		std::size_t num_pixels) {
+	const std::size_t pixel_size = num_time_slices_ * num_bands_;
+	std::vector<TimeSeries<T>> time_series;
+	time_series.reserve(num_pixels);
+	for (std::size_t i = 0; i < num_pixels; ++i) {
+		time_series.push_back(
+				TimeSeries<T>(values + i * pixel_size, num_time_slices_,
+						num_bands_));
+	}
+	std::vector<int> results = process_chunk(std::move(time_series));
+	if (results.size() != num_pixels) {
+		failed_ = true;
+		results.resize(num_pixels, -1);
+	}
+	return results;
+}
+
+template<typename T>
+int WorkStealingScheduler<T>::StealChunk(int task, std::vector<T> &values,
+		std::size_t &num_pixels) {
+	MPI_Send(nullptr, 0, MPI_INT, task, kChunkRequestTag, run_communicator_);
+	// Serves the requests of others while waiting, since they may be
+	// waiting for this task as well.
+	while (true) {
+		MPI_Status status;
+		MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, run_communicator_, &status);
+		if (status.MPI_TAG == kChunkTag)
+			break;
+		ServeMessage(status);
+	}
+	int chunk[2];
+	MPI_Recv(chunk, 2, MPI_INT, task, kChunkTag, run_communicator_,
+			MPI_STATUS_IGNORE);
+	if (chunk[0] < 0) {
+		return -1;
+	}
+	num_pixels = chunk[1];
+	values.resize(num_pixels * num_time_slices_ * num_bands_);
+	MPI_Recv(values.data(), values.size(), GetDataType<T>(), task, kChunkValuesTag,
+			run_communicator_, MPI_STATUS_IGNORE);
+	return chunk[0];
+}
+
+template<typename T>
+void WorkStealingScheduler<T>::ServeMessages() {
+	const int tags[] = { kChunkRequestTag, kResultsTag };
+	for (bool served = true; served;) {
+		served = false;
+		for (int tag : tags) {
+			int flag;
+			MPI_Status status;
+			MPI_Iprobe(MPI_ANY_SOURCE, tag, run_communicator_, &flag, &status);
+			if (flag) {
+				ServeMessage(status);
+				served = true;
+			}
+		}
+	}
+}
+
+template<typename T>
+void WorkStealingScheduler<T>::ServeMessage(const MPI_Status &status) {
+	const int task = status.MPI_SOURCE;
+	if (status.MPI_TAG == kChunkRequestTag) {
+		MPI_Recv(nullptr, 0, MPI_INT, task, kChunkRequestTag, run_communicator_,
+				MPI_STATUS_IGNORE);
+		// Hands out the chunks this task would process last.
+		int chunk[2] = { -1, 0 };
+		if (front_ < back_) {
+			chunk[0] = --back_;
+			chunk[1] = GetChunkSize(chunk[0]);
+		}
+		MPI_Send(chunk, 2, MPI_INT, task, kChunkTag, run_communicator_);
+		if (chunk[0] >= 0) {
+			const std::size_t pixel_size = num_time_slices_ * num_bands_;
+			send_requests_.push_back(MPI_REQUEST_NULL);
+			MPI_Isend(
+					data_
+							+ static_cast<std::size_t>(chunk[0])
+									* num_pixels_per_chunk_ * pixel_size,
+					chunk[1] * pixel_size, GetDataType<T>(), task, kChunkValuesTag,
+					run_communicator_, &send_requests_.back());
+			++num_pending_results_;
+		}
+	} else if (status.MPI_TAG == kResultsTag) {
+		int count;
+		MPI_Get_count(&status, MPI_INT, &count);
+		std::vector<int> results(count);
+		MPI_Recv(results.data(), count, MPI_INT, task, kResultsTag,
+				run_communicator_, MPI_STATUS_IGNORE);
+		const int chunk = results[0];
+		std::copy(results.begin() + 1, results.end(),
+				results_.begin()
+						+ static_cast<std::size_t>(chunk) * num_pixels_per_chunk_);
+		--num_pending_results_;
+	}
+}
+
+template<typename T>
+std::size_t WorkStealingScheduler<T>::GetChunkSize(int chunk) const {
+	const std::size_t first_pixel = static_cast<std::size_t>(chunk)
+			* num_pixels_per_chunk_;
+	return std::min(num_pixels_ - first_pixel,
+			static_cast<std::size_t>(num_pixels_per_chunk_));
+}
+
+template class WorkStealingScheduler<float>;
+template class WorkStealingScheduler<std::int16_t>;
+template class WorkStealingScheduler<std::uint16_t>;
+
+} /* namespace remote_sensing */
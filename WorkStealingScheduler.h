@@ -0,0 +1,133 @@
+/*
+ * WorkStealingScheduler.h
+ *
+ *  Author: RSSI (rssiuiuc@gmail.com)
+ */
+
+#ifndef SIMPLEGRAPH_PHENONET_WORKSTEALINGSCHEDULER_H_
+#define SIMPLEGRAPH_PHENONET_WORKSTEALINGSCHEDULER_H_
+
+#include "TimeSeries.h"
+
+#include <mpi.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace remote_sensing {
+
+/*
+ * Balances the processing of the pixels of a communicator at run time. The
+ * cost per pixel varies a lot (fragmented, water and no-data pixels are
+ * rejected early while crop pixels run the full network analysis), so an
+ * equal number of pixels per task leaves tasks idle while others still run.
+ *
+ * The pixels of each task are divided into chunks of contiguous pixels. A
+ * task processes its own chunks from the front; once they are gone it asks
+ * the other tasks in turn for chunks, which they hand out from the back
+ * along with their time series, and sends the results back to the owner.
+ * Requests are answered between two chunks, so the wait of a stealing task
+ * is bounded by the time of one chunk. Only the main thread makes MPI calls
+ * (MPI_THREAD_FUNNELED is enough), and no progress thread is needed since
+ * tasks never access the memory of others directly.
+ *
+ * All pixels of the communicator must have the same number of time slices
+ * and bands, as after TimeSeriesDecomposition. The values are float, or
+ * int16_t and uint16_t for quantized time series, which halves the volume
+ * of the stolen chunks.
+ */
+template<typename T>
+class WorkStealingScheduler {
+public:
+	// Processes the time series of a chunk of pixels and returns one result
+	// per pixel, in the same order. The time series are views that are only
+	// valid during the call.
+	typedef std::function<
+			std::vector<int>(std::vector<TimeSeries<T>> &&time_series)> ChunkProcessor;
+
+	// Takes the time series of the pixels of this task, which are processed
+	// in chunks of num_pixels_per_chunk pixels. The values are copied unless
+	// the time series are views of one contiguous array (e.g. the
+	// node-shared window of TimeSeriesDecomposition), which is then used in
+	// place and must outlive Run().
+	WorkStealingScheduler(std::vector<TimeSeries<T>> &&time_series,
+			int num_pixels_per_chunk, MPI_Comm communicator = MPI_COMM_WORLD);
+
+	virtual ~WorkStealingScheduler();
+	WorkStealingScheduler(const WorkStealingScheduler &other) = delete;
+	WorkStealingScheduler& operator=(const WorkStealingScheduler &other) = delete;
+
+	// Processes all chunks of all tasks. This is collective over the
+	// communicator and only returns once every chunk has been processed.
+	// Returns false on all tasks if the time series do not have the same
+	// dimensions or a chunk does not get one result per pixel.
+	bool Run(const ChunkProcessor &process_chunk);
+
+	// The results of the pixels of this task, in their original order.
+	inline const std::vector<int>& GetResults() const {
+		return results_;
+	}
+
+	// The number of chunks this task took from other tasks in Run().
+	inline int GetNumStolenChunks() const {
+		return num_stolen_chunks_;
+	}
+
+private:
+	const MPI_Comm communicator_;
+	const int num_pixels_per_chunk_;
+	int rank_;
+	int size_;
+	std::size_t num_pixels_;
+	std::size_t num_time_slices_;
+	std::size_t num_bands_;
+	// Whether all pixels of this task have the same dimensions.
+	bool valid_;
+	// The values of all pixels of this task, pixel by pixel, either values_
+	// or the viewed array.
+	const T *data_;
+	std::vector<T> values_;
+	// The results of the pixels of this task.
+	std::vector<int> results_;
+	int num_stolen_chunks_;
+
+	// The state of Run(). Messages are exchanged on a duplicate of the
+	// communicator so they cannot match those of the caller.
+	MPI_Comm run_communicator_;
+	// The chunks of this task that are not taken yet, [front_, back_).
+	int front_;
+	int back_;
+	// The number of chunks of this task taken by others whose results have
+	// not arrived yet.
+	int num_pending_results_;
+	// The messages sent without waiting, which are completed at the end of
+	// Run(), and the results they send.
+	std::vector<MPI_Request> send_requests_;
+	std::vector<std::vector<int>> sent_results_;
+	// Set if a chunk did not get one result per pixel.
+	bool failed_;
+
+	// Checks that all tasks have time series of the same dimensions.
+	bool ValidateDimensions();
+
+	// Processes a chunk and checks the number of results.
+	std::vector<int> ProcessChunk(const ChunkProcessor &process_chunk,
+			const T *values, std::size_t num_pixels);
+
+	// Asks a task for one of its chunks and receives its time series,
+	// serving messages meanwhile. Returns -1 if the task has none left.
+	int StealChunk(int task, std::vector<T> &values,
+			std::size_t &num_pixels);
+
+	// Serves the messages that have arrived, without waiting.
+	void ServeMessages();
+
+	// Answers a chunk request or receives the results of a chunk.
+	void ServeMessage(const MPI_Status &status);
+
+	std::size_t GetChunkSize(int chunk) const;
+};
+
+} /* namespace remote_sensing */
+
+#endif /* SIMPLEGRAPH_PHENONET_WORKSTEALINGSCHEDULER_H_ */